@@ -12,11 +12,17 @@
 #include <sys/types.h>
 #include <sys/ipc.h>
 
-#define SHMKEY 0x1234
-#define MSGKEY ftok("oss.c", 1)
 #define PAGE_SIZE 1024
 #define NUM_PAGES_PER_PROCESS 32
 #define NUM_FRAMES 256
+#define MAX_HUGE_PAGE_FRAMES 32
+
+// Message readWrite values, the last two are only used by pooled workers
+#define MSG_READ 0 // Read reference
+#define MSG_WRITE 1 // Write reference
+#define MSG_EXIT 2 // Worker finished its workload and parked
+#define MSG_ASSIGN 3 // oss hands a parked worker a workload, address holds its seed
+#define DEFAULT_WRITE_PERCENT 15
 
 // SystemClock struct
 struct SystemClock {
@@ -27,7 +33,7 @@ struct SystemClock {
 struct messageData {
     pid_t pid; // Process ID
     int address; // Address
-    int readWrite; // Read or write
+    int readWrite; // Read or write, or a pool command
 };
 
 // Message queue struct
@@ -44,6 +50,8 @@ struct PCB {
     int eventWaitNano; // when does its event happen?
     int neededPage; // what page does it need?
     int blocked; // is this process waiting on event?
+    int residentHead; // first frame in its resident page list
+    int residentCount; // how many of its pages are in frames
 };
 
 // Page table struct
@@ -53,15 +61,41 @@ struct PageTable {
     int dirty; // Dirty, used for dirty bit (read/write)
     int valid; // Valid, used for valid bit (in memory)
     int referenced; // Referenced
+    int huge; // Part of a huge page
 };
 
 // Frame table struct
 struct FrameTable {
     int occupied; // Occupied
-    int page; // Page number
+    int page; // Page table entry, which is also the reverse map: owner slot page / NUM_PAGES_PER_PROCESS, vpn page % NUM_PAGES_PER_PROCESS
     int dirty; // Dirty
     int valid; // Valid
     int headOfQueue; // Head of queue
+    int nextResident; // Next frame in the owner's resident list, or in the free list when free
+    int prevResident; // Previous frame in the owner's resident list, or in the free list when free
+};
+
+// Live counters oss publishes for ossstat. oss bumps seq to odd before updating and back to even after,
+// so a reader retries if seq was odd or changed while it copied.
+#define TELEMETRY_NAME_FORMAT "/oss.%d.telemetry"
+struct Telemetry {
+    unsigned int seq; // Sequence count
+    int finished; // oss has shut down
+    unsigned int seconds; // Simulated seconds
+    unsigned int nanoseconds; // Simulated nanoseconds
+    int activeProcesses; // Processes running
+    int blockedProcesses; // Processes waiting on a page fault
+    int launchedProcesses; // Processes launched so far
+    int numFrames; // Frames configured with -m
+    int freeFrames; // Frames holding no page
+    int queueDepth; // Requests queued across the paging devices
+    unsigned long references; // Memory references handled
+    unsigned long pageFaults; // References that faulted
+    unsigned long evictions; // Pages evicted
+    unsigned long writebacks; // Dirty pages written back
+    unsigned long tlbHits; // References translated by the TLB
+    int zswapUsed; // Compressed bytes held in the zswap pool
+    unsigned long zswapHits; // Faults restored from the zswap pool
 };
 
 // Function prototypes
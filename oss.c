@@ -3,11 +3,127 @@
 #include <fcntl.h>
 #include <time.h>
 #include <string.h>
+#include <signal.h>
+#include <spawn.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "header.h"
 
 #define _GNU_SOURCE
 #define MAX_PROCESSES 18
+#define CHECKPOINT_MAGIC 0x4F53534B
+#define CHECKPOINT_VERSION 1
+#define RNG_STATE_SIZE 256
+#define TLB_ENTRIES 16
+#define PAGE_MIGRATE_TIME 100000
+#define MAX_DEVICES 4
+#define IO_QUEUE_SIZE 128
+#define MAX_MERGE 8
+#define STRIPE_PAGES 8
+#define IO_OVERHEAD_TIME 2000000
+#define IO_SEEK_TIME 2000000
+#define IO_SEEK_SLOT_TIME 10000
+#define IO_TRANSFER_TIME 10000000
+#define READ_DEADLINE 50000000
+#define WRITE_DEADLINE 250000000
+#define ZSWAP_COMPRESS_TIME 100000
+#define ZSWAP_DECOMPRESS_TIME 50000
+
+// Paging device schedulers
+enum { SCHED_FCFS, SCHED_SSTF, SCHED_DEADLINE };
+
+// Simulation statistics
+struct Stats {
+    unsigned long references; // Memory references handled
+    unsigned long reads; // Read references
+    unsigned long writes; // Write references
+    unsigned long pageFaults; // References that faulted
+    unsigned long evictions; // Pages evicted from a frame
+    unsigned long tlbHits; // References translated by the TLB
+    unsigned long tlbMisses; // References that needed a page table walk
+    unsigned long promotions; // Regions promoted to huge pages
+    unsigned long demotions; // Huge pages split back into base pages
+    unsigned long writebacks; // Write backs queued on the paging devices, not counting dropped ones
+    unsigned long long bytesIn; // Bytes copied from the swap file into frames
+    unsigned long long bytesOut; // Bytes copied from frames to the swap file
+    unsigned long long pagingNanos; // Real time spent copying pages
+    unsigned long ioRequests; // Requests queued on the paging devices
+    unsigned long ioMerges; // Requests merged into a neighbour's transfer
+    unsigned long faultsServiced; // Faults the paging devices completed
+    unsigned long long faultLatency; // Total simulated nanoseconds from fault to reply
+    unsigned long long maxFaultLatency; // Longest simulated fault
+    int maxQueueDepth; // Deepest any device queue got
+    unsigned long zswapStores; // Evicted pages compressed into the pool
+    unsigned long zswapHits; // Faults restored from the pool without the paging devices
+    unsigned long zswapWritebacks; // Pages pushed out of the pool to make room
+};
+
+// Paging device request
+struct IORequest {
+    int entry; // Page table entry, which is also its swap slot
+    int index; // Process table index waiting on it, -1 for a write back
+    int write; // Write back rather than a fault
+    long long arrival; // Simulated time it was queued
+    long long deadline; // Simulated time it should be started by
+    long long finish; // Simulated time its transfer finishes, set when it is dispatched
+};
+
+// Simulated paging device
+struct Device {
+    struct IORequest queue[IO_QUEUE_SIZE]; // Waiting requests, oldest first
+    int queueLength; // Number of waiting requests
+    struct IORequest current[MAX_MERGE]; // Requests being transferred together
+    int numCurrent; // Number of requests being transferred
+    long long busyUntil; // When the current transfer finishes, or when the device went idle
+    int headPosition; // Device slot under the head
+};
+
+// Compressed pool slot, one per page table entry
+struct ZswapEntry {
+    int stored; // Page is held in the pool
+    int size; // Compressed size in bytes
+    int dirty; // Pool copy is newer than the paging device's
+    int older; // Next older page in the pool, -1 at the oldest
+    int newer; // Next newer page in the pool, -1 at the newest
+};
+
+// TLB entry, covers one page or one huge page
+struct TLBEntry {
+    int valid; // Valid
+    int entry; // First page table entry covered
+    int huge; // Covers a whole huge page
+};
+
+// Simulation state, kept in one block so a checkpoint can be restored with a single mapping
+struct SimState {
+    unsigned int magic; // Checkpoint magic number
+    unsigned int version; // Checkpoint layout version
+    size_t size; // Size of this struct when the checkpoint was written
+    struct SystemClock clock; // Simulated clock at checkpoint time
+    int numActiveProcesses; // Number of active processes
+    int numLaunchedProcesses; // Number of launched processes
+    int nextReplayPid; // Next pid handed out to a simulated child in replay mode
+    int numFrames; // Number of frames in use, at most NUM_FRAMES
+    int freeHead; // First free frame, -1 when every frame holds a page
+    int fifoHead; // Frame at the head of the FIFO queue
+    int hugePageFrames; // Frames per huge page, 1 when huge pages are off
+    struct TLBEntry tlb[TLB_ENTRIES]; // Simulated TLB
+    int tlbNext; // Next TLB entry to replace
+    int numDevices; // Number of paging devices, swap slots are striped across them
+    struct Device devices[MAX_DEVICES]; // Paging devices and their queues
+    struct ZswapEntry zswap[NUM_PAGES_PER_PROCESS * MAX_PROCESSES]; // Compressed pool, indexed by page table entry
+    int zswapOldest; // Oldest page in the pool, first to go to the paging devices
+    int zswapNewest; // Newest page in the pool
+    int zswapUsed; // Compressed bytes held in the pool
+    struct Stats stats; // Simulation statistics
+    int replayExited[MAX_PROCESSES]; // Simulated children that decided to terminate
+    struct PCB processTable[MAX_PROCESSES]; // Process table
+    struct PageTable pageTable[NUM_PAGES_PER_PROCESS * MAX_PROCESSES]; // Page table
+    struct FrameTable frameTable[NUM_FRAMES]; // Frame table, including FIFO head of queue
+    char rngState[RNG_STATE_SIZE]; // State buffer used by random()
+};
 
 // Global variables
 int shmid;
@@ -15,17 +131,47 @@ int msqid;
 char logMessage[150];
 struct SystemClock *sysClock;
 struct msgbuf inbox, outbox;
-struct PCB processTable[MAX_PROCESSES];
+struct SimState *simState;
+struct PCB *processTable;
 struct PageTable *pageTable;
 struct FrameTable *frameTable;
 struct timespec lastOutputTime, currentTime;
+char *checkpointFile = NULL;
+int replayMode = 0;
+volatile sig_atomic_t stopSignal = 0;
+int numFrames = NUM_FRAMES;
+int hugePageFrames = 1;
+int numDevices = 1;
+int ioScheduler = SCHED_FCFS;
+int mergeRequests = 0;
+int zswapSize = 0;
+double zswapRatio = 3.0;
+char *swapFile = NULL;
+char *framePool = NULL;
+char *swapArea = NULL;
+char *zswapArea = NULL;
+long hostPageSize = 0;
+volatile char dataSink;
+int usePool = 1;
+pid_t workerPids[MAX_PROCESSES];
+int workerBusy[MAX_PROCESSES];
+int numWorkers = 0;
+pid_t pendingExitPid = 0;
+struct timespec startTime;
+struct Telemetry *telemetry = NULL;
+char telemetryName[64];
+
+extern char **environ;
+int writePercent = DEFAULT_WRITE_PERCENT;
+int lifetime = 0;
 
 /* INIT FUNCTIONS */
 
 // Init shared memory
 void initSharedMemory() {
     // Get shared memory
-    shmid = shmget(SHMKEY, sizeof(struct SystemClock), IPC_CREAT | 0666);
+    // Private to this run, children get the id on their command line
+    shmid = shmget(IPC_PRIVATE, sizeof(struct SystemClock), IPC_CREAT | 0600);
     if (shmid == -1) {
         perror("oss: Error: Failed to get shared memory");
         exit(EXIT_FAILURE);
@@ -49,13 +195,51 @@ void initSystemClock() {
 // Init message queue
 void initMessageQueue() {
     // Get message queue
-    msqid = msgget(MSGKEY, IPC_CREAT | 0666);
+    // Private to this run, children get the id on their command line
+    msqid = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
     if (msqid == -1) {
         perror("oss: Error: Failed to get message queue");
         exit(EXIT_FAILURE);
     }
 }
 
+// Init simulation state
+void initSimState() {
+    // Map an anonymous block for the simulation state
+    simState = mmap(NULL, sizeof(struct SimState), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (simState == MAP_FAILED) {
+        perror("oss: Error: Failed to map simulation state");
+        exit(EXIT_FAILURE);
+    }
+
+    // Initialize header and counters
+    simState->magic = CHECKPOINT_MAGIC;
+    simState->version = CHECKPOINT_VERSION;
+    simState->size = sizeof(struct SimState);
+    simState->numActiveProcesses = 0;
+    simState->numLaunchedProcesses = 0;
+    simState->nextReplayPid = 1;
+    simState->numFrames = numFrames;
+    simState->hugePageFrames = hugePageFrames;
+    memset(&simState->stats, 0, sizeof(struct Stats));
+    memset(simState->tlb, 0, sizeof(simState->tlb));
+    simState->tlbNext = 0;
+    simState->numDevices = numDevices;
+    memset(simState->devices, 0, sizeof(simState->devices));
+    memset(simState->zswap, 0, sizeof(simState->zswap));
+    simState->zswapOldest = -1;
+    simState->zswapNewest = -1;
+    simState->zswapUsed = 0;
+
+    // Point the tables into the state block
+    processTable = simState->processTable;
+    pageTable = simState->pageTable;
+    frameTable = simState->frameTable;
+
+    // Seed random number generator with a state buffer we can checkpoint
+    initstate(time(NULL), simState->rngState, RNG_STATE_SIZE);
+}
+
 // Init process table
 void initProcessTable() {
     // Initialize process table
@@ -66,18 +250,14 @@ void initProcessTable() {
         processTable[i].eventWaitNano = 0;
         processTable[i].neededPage = -1;
         processTable[i].blocked = 0;
+        processTable[i].residentHead = -1;
+        processTable[i].residentCount = 0;
+        simState->replayExited[i] = 0;
     }
 }
 
 // Init page table
 void initPageTable() {
-    // Allocate memory for page table
-    pageTable = malloc(NUM_PAGES_PER_PROCESS * MAX_PROCESSES * sizeof(struct PageTable));
-    if (pageTable == NULL) {
-        perror("oss: Error: Failed to allocate memory for page table");
-        exit(EXIT_FAILURE);
-    }
-    
     // Initialize page table
     for (int i = 0; i < NUM_PAGES_PER_PROCESS * MAX_PROCESSES; i++) {
         pageTable[i].pid = -1;
@@ -85,18 +265,12 @@ void initPageTable() {
         pageTable[i].dirty = 0;
         pageTable[i].valid = 1;
         pageTable[i].referenced = 0;
+        pageTable[i].huge = 0;
     }
 }
 
 // Init frame table
 void initFrameTable() {
-    // Allocate memory for frame table
-    frameTable = malloc(NUM_FRAMES * sizeof(struct FrameTable));
-    if (frameTable == NULL) {
-        perror("oss: Error: Failed to allocate memory for frame table");
-        exit(EXIT_FAILURE);
-    }
-    
     // Initialize frame table
     for (int i = 0; i < NUM_FRAMES; i++) {
         frameTable[i].occupied = 0;
@@ -104,10 +278,43 @@ void initFrameTable() {
         frameTable[i].dirty = 0;
         frameTable[i].valid = 1;
         frameTable[i].headOfQueue = 0;
+        frameTable[i].nextResident = -1;
+        frameTable[i].prevResident = -1;
     }
 
     // Set head of queue to first frame
     frameTable[0].headOfQueue = 1;
+    simState->fifoHead = 0;
+}
+
+// Put every frame in use on the free list, lowest first
+void initFreeList() {
+    for (int i = 0; i < numFrames; i++) {
+        frameTable[i].prevResident = i - 1;
+        frameTable[i].nextResident = i + 1 < numFrames ? i + 1 : -1;
+    }
+    simState->freeHead = 0;
+}
+
+// Init telemetry page for ossstat
+void initTelemetry() {
+    // Named after our pid so ossstat can find it
+    sprintf(telemetryName, TELEMETRY_NAME_FORMAT, getpid());
+    int fd = shm_open(telemetryName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("oss: Error: Failed to create telemetry page");
+        exit(EXIT_FAILURE);
+    }
+    if (ftruncate(fd, sizeof(struct Telemetry)) == -1) {
+        perror("oss: Error: Failed to size telemetry page");
+        exit(EXIT_FAILURE);
+    }
+    telemetry = mmap(NULL, sizeof(struct Telemetry), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (telemetry == MAP_FAILED) {
+        perror("oss: Error: Failed to map telemetry page");
+        exit(EXIT_FAILURE);
+    }
 }
 
 void initLogFile(char* logfile) {
@@ -139,24 +346,22 @@ void advanceClock(int nanoseconds) {
 }
 
 // Get simulated clock time
-int getClockTime() {
-    return sysClock->seconds * 1000000000 + sysClock->nanoseconds;
+long long getClockTime() {
+    return sysClock->seconds * 1000000000LL + sysClock->nanoseconds;
 }
 
 // Get frame table entry by head of queue
 int getFrameTableEntryByHeadOfQueue() {
-    for (int i = 0; i < NUM_FRAMES; i++) {
-        if (frameTable[i].headOfQueue == 1) {
-            return i;
-        }
-    }
-    
-    perror("oss: Error: Failed to get frame table entry by head of queue");
-    return -1;
+    return simState->fifoHead;
 }
 
 // Function to handle signals
 void handleSignal(int sig) {
+	// Let the main loop finish its iteration so the summary and checkpoint are consistent, a second signal exits right away
+	if (stopSignal == 0) {
+		stopSignal = sig;
+		return;
+	}
 	if (sig == SIGINT) {
 		sprintf(logMessage, "OSS: Caught SIGINT, exiting...\n");
 		printf("%s", logMessage);
@@ -165,7 +370,11 @@ void handleSignal(int sig) {
 		printf("%s", logMessage);
 	}
 	shmctl(shmid, IPC_RMID, NULL);
-	msgctl(msgget(ftok("oss.c", 1), 0666 | IPC_CREAT), IPC_RMID, NULL);
+	msgctl(msqid, IPC_RMID, NULL);
+	if (telemetry != NULL) {
+		telemetry->finished = 1;
+	}
+	shm_unlink(telemetryName);
 	exit(0);
 }
 
@@ -183,6 +392,1135 @@ void writeLog(const char* logfile, const char* message) {
 
 /* END MISC FUNCTIONS */
 
+/* CHECKPOINT FUNCTIONS */
+
+// Save simulation state to a checkpoint file
+void saveCheckpoint(const char* filename) {
+    // Copy the clock and sync the random() position into the state block
+    simState->clock = *sysClock;
+    setstate(simState->rngState);
+
+    // Open checkpoint file
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        perror("oss: Error: Failed to open checkpoint file");
+        return;
+    }
+
+    // Write the state block as-is so it can be mapped back in
+    char *data = (char *)simState;
+    size_t remaining = sizeof(struct SimState);
+    while (remaining > 0) {
+        ssize_t written = write(fd, data, remaining);
+        if (written < 0) {
+            perror("oss: Error: Failed to write checkpoint file");
+            close(fd);
+            return;
+        }
+        data += written;
+        remaining -= written;
+    }
+
+    close(fd);
+}
+
+// Restore simulation state from a checkpoint file
+void restoreCheckpoint(const char* filename) {
+    // Open checkpoint file
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("oss: Error: Failed to open checkpoint file");
+        exit(EXIT_FAILURE);
+    }
+
+    // Make sure the file is the size of our state block
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size != sizeof(struct SimState)) {
+        fprintf(stderr, "oss: Error: Checkpoint file %s does not match this build\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    // Map the checkpoint privately so the file itself is never modified
+    struct SimState *restored = mmap(NULL, sizeof(struct SimState), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (restored == MAP_FAILED) {
+        perror("oss: Error: Failed to map checkpoint file");
+        exit(EXIT_FAILURE);
+    }
+
+    // Validate header
+    if (restored->magic != CHECKPOINT_MAGIC || restored->version != CHECKPOINT_VERSION || restored->size != sizeof(struct SimState)) {
+        fprintf(stderr, "oss: Error: Checkpoint file %s does not match this build\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    // Swap in the restored state, switching random() over before the old buffer goes away
+    setstate(restored->rngState);
+    munmap(simState, sizeof(struct SimState));
+    simState = restored;
+    processTable = simState->processTable;
+    pageTable = simState->pageTable;
+    frameTable = simState->frameTable;
+    *sysClock = simState->clock;
+    numFrames = simState->numFrames;
+    hugePageFrames = simState->hugePageFrames;
+    numDevices = simState->numDevices;
+
+    // Simulated pids must not collide with the real pids of the restored children
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        if (processTable[i].occupied == 1 && processTable[i].pid >= simState->nextReplayPid) {
+            simState->nextReplayPid = processTable[i].pid + 1;
+        }
+    }
+
+    // The original children are gone, so simulate them from here on
+    replayMode = 1;
+}
+
+/* END CHECKPOINT FUNCTIONS */
+
+/* CHILD FUNCTIONS */
+
+// Spawn a parked user_proc worker into a pool slot
+void spawnWorker(int i) {
+    char shmidArg[16], msqidArg[16], writePercentArg[16], lifetimeArg[16];
+    sprintf(shmidArg, "%d", shmid);
+    sprintf(msqidArg, "%d", msqid);
+    sprintf(writePercentArg, "%d", writePercent);
+    sprintf(lifetimeArg, "%d", lifetime);
+    char *args[] = { "user_proc", shmidArg, msqidArg, writePercentArg, lifetimeArg, "pool", NULL };
+
+    // posix_spawn returns the error rather than setting errno
+    int error = posix_spawn(&workerPids[i], "./user_proc", NULL, NULL, args, environ);
+    if (error != 0) {
+        fprintf(stderr, "oss: Error: Failed to spawn worker: %s\n", strerror(error));
+        exit(EXIT_FAILURE);
+    }
+    workerBusy[i] = 0;
+}
+
+// Spawn the pool of parked user_proc workers
+void initWorkerPool(int size) {
+    for (int i = 0; i < size; i++) {
+        spawnWorker(i);
+        numWorkers++;
+    }
+}
+
+// Hand a parked worker a new workload, returns its pid or -1 if every worker is busy
+pid_t assignWorker() {
+    for (int i = 0; i < numWorkers; i++) {
+        if (workerBusy[i] == 0) {
+            workerBusy[i] = 1;
+            outbox.mType = workerPids[i];
+            outbox.mData.pid = workerPids[i];
+            outbox.mData.address = random();
+            outbox.mData.readWrite = MSG_ASSIGN;
+            if (msgsnd(msqid, &outbox, sizeof(outbox.mData), 0) == -1) {
+                perror("oss: Error: Failed to send message to worker");
+                exit(EXIT_FAILURE);
+            }
+            return workerPids[i];
+        }
+    }
+    return -1;
+}
+
+// Mark a worker parked again, or replace it if it died
+void releaseWorker(pid_t pid, int died) {
+    for (int i = 0; i < numWorkers; i++) {
+        if (workerPids[i] == pid) {
+            workerBusy[i] = 0;
+            if (died) {
+                workerPids[i] = -1;
+                spawnWorker(i);
+            }
+            return;
+        }
+    }
+}
+
+// Launch a child, or hand out a pid for a simulated child in replay mode
+pid_t launchChild() {
+    if (replayMode) {
+        return simState->nextReplayPid++;
+    }
+    if (usePool) {
+        return assignWorker();
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        char shmidArg[16], msqidArg[16], writePercentArg[16], lifetimeArg[16];
+        sprintf(shmidArg, "%d", shmid);
+        sprintf(msqidArg, "%d", msqid);
+        sprintf(writePercentArg, "%d", writePercent);
+        sprintf(lifetimeArg, "%d", lifetime);
+        execl("./user_proc", "user_proc", shmidArg, msqidArg, writePercentArg, lifetimeArg, NULL);
+        exit(0);
+    }
+    return pid;
+}
+
+// Reap a terminated child, returns its pid or 0 if none
+pid_t reapChild() {
+    if (!replayMode) {
+        // A pooled worker said it finished its workload
+        if (pendingExitPid > 0) {
+            pid_t pid = pendingExitPid;
+            pendingExitPid = 0;
+            releaseWorker(pid, 0);
+            return pid;
+        }
+
+        // A worker that dies is replaced with a fresh one
+        int status;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid > 0) {
+            releaseWorker(pid, 1);
+        }
+        return pid;
+    }
+
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        if (simState->replayExited[i] == 1) {
+            simState->replayExited[i] = 0;
+            return processTable[i].pid;
+        }
+    }
+    return 0;
+}
+
+// Receive a request from a child, or generate one the way user_proc does in replay mode
+int receiveRequest() {
+    if (!replayMode) {
+        if (msgrcv(msqid, &inbox, sizeof(inbox.mData), 1, IPC_NOWAIT) == -1) {
+            return 0;
+        }
+
+        // A pooled worker finished, it is reaped at the top of the next loop
+        if (inbox.mData.readWrite == MSG_EXIT) {
+            pendingExitPid = inbox.mData.pid;
+            return 0;
+        }
+        return 1;
+    }
+
+    // Pick a simulated child that is not blocked or on its way out
+    int candidates[MAX_PROCESSES];
+    int numCandidates = 0;
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        if (processTable[i].occupied == 1 && processTable[i].blocked == 0 && simState->replayExited[i] == 0) {
+            candidates[numCandidates++] = i;
+        }
+    }
+    if (numCandidates == 0) {
+        return 0;
+    }
+    int i = candidates[random() % numCandidates];
+
+    // Generate page, offset and read/write
+    inbox.mType = 1;
+    inbox.mData.pid = processTable[i].pid;
+    inbox.mData.address = (random() % NUM_PAGES_PER_PROCESS) * PAGE_SIZE + random() % PAGE_SIZE;
+    inbox.mData.readWrite = (random() % 100) < 100 - writePercent ? MSG_READ : MSG_WRITE;
+    return 1;
+}
+
+// Reply to a child, or decide whether a simulated child terminates in replay mode
+void replyToChild(pid_t pid) {
+    if (!replayMode) {
+        outbox.mType = pid;
+        if (msgsnd(msqid, &outbox, sizeof(outbox.mData), 0) == -1) {
+            perror("oss: Error: Failed to send message to child");
+            exit(EXIT_FAILURE);
+        }
+        return;
+    }
+
+    // Same termination odds as user_proc
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        if (processTable[i].occupied == 1 && processTable[i].pid == pid) {
+            if (lifetime > 0 ? random() % lifetime == 0 : random() % 1100 >= 900) {
+                simState->replayExited[i] = 1;
+            }
+            break;
+        }
+    }
+}
+
+/* END CHILD FUNCTIONS */
+
+/* BACKING STORE FUNCTIONS */
+
+// Size of the swap file, one page for every page table entry
+#define SWAP_SIZE ((size_t)NUM_PAGES_PER_PROCESS * MAX_PROCESSES * PAGE_SIZE)
+
+// Get real nanoseconds since a start time
+long long getElapsedNanos(struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000000LL + (now.tv_nsec - start->tv_nsec);
+}
+
+// Map the frame pool and the swap file, keeping the swap file's contents when resuming
+void initBackingStore(int resuming) {
+    // madvise works on whole host pages, each holding several frames
+    hostPageSize = sysconf(_SC_PAGESIZE);
+
+    // Frames are one anonymous region
+    framePool = mmap(NULL, (size_t)NUM_FRAMES * PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (framePool == MAP_FAILED) {
+        perror("oss: Error: Failed to map frame pool");
+        exit(EXIT_FAILURE);
+    }
+
+    // Each page table entry is backed by its own page of the swap file
+    int fd = open(swapFile, O_RDWR | O_CREAT | (resuming ? 0 : O_TRUNC), 0666);
+    if (fd < 0) {
+        perror("oss: Error: Failed to open swap file");
+        exit(EXIT_FAILURE);
+    }
+    if (ftruncate(fd, SWAP_SIZE) == -1) {
+        perror("oss: Error: Failed to size swap file");
+        exit(EXIT_FAILURE);
+    }
+    swapArea = mmap(NULL, SWAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (swapArea == MAP_FAILED) {
+        perror("oss: Error: Failed to map swap file");
+        exit(EXIT_FAILURE);
+    }
+
+    // Faults land all over the swap file, so readahead only wastes I/O
+    madvise(swapArea, SWAP_SIZE, MADV_RANDOM);
+
+    // The compressed pool keeps a page's encoding in a slot of its own, the pool size only limits how many bytes are in use
+    zswapArea = mmap(NULL, SWAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (zswapArea == MAP_FAILED) {
+        perror("oss: Error: Failed to map compressed pool");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Hint that a faulting page will be read soon, so the kernel can start the read while the child waits
+void prefetchPage(int entry) {
+    if (swapArea == NULL) {
+        return;
+    }
+
+    // Widen the page out to the host pages holding it
+    size_t start = (size_t)entry * PAGE_SIZE / hostPageSize * hostPageSize;
+    size_t end = ((size_t)(entry + 1) * PAGE_SIZE + hostPageSize - 1) / hostPageSize * hostPageSize;
+    if (madvise(swapArea + start, end - start, MADV_WILLNEED) == -1) {
+        perror("oss: Error: Failed to prefetch swap page");
+    }
+}
+
+// Copy a page from the swap file into its frame
+void swapIn(int entry, int frame) {
+    if (framePool == NULL) {
+        return;
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    memcpy(framePool + (size_t)frame * PAGE_SIZE, swapArea + (size_t)entry * PAGE_SIZE, PAGE_SIZE);
+    simState->stats.pagingNanos += getElapsedNanos(&start);
+    simState->stats.bytesIn += PAGE_SIZE;
+}
+
+// Copy a page from its frame back to the swap file
+void swapOut(int entry, int frame) {
+    if (framePool == NULL) {
+        return;
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    memcpy(swapArea + (size_t)entry * PAGE_SIZE, framePool + (size_t)frame * PAGE_SIZE, PAGE_SIZE);
+    simState->stats.pagingNanos += getElapsedNanos(&start);
+    simState->stats.bytesOut += PAGE_SIZE;
+}
+
+// Run-length encode a page, returns the encoded size or -1 if it does not fit in less than a page
+int compressPage(const char *page, char *out) {
+    int size = 0;
+    for (int i = 0; i < PAGE_SIZE; ) {
+        int run = 1;
+        while (i + run < PAGE_SIZE && run < 255 && page[i + run] == page[i]) {
+            run++;
+        }
+        if (size + 2 >= PAGE_SIZE) {
+            return -1;
+        }
+        out[size++] = (char)run;
+        out[size++] = page[i];
+        i += run;
+    }
+    return size;
+}
+
+// Decode a run-length encoded page
+void decompressPage(const char *in, char *page) {
+    for (int i = 0; i < PAGE_SIZE; in += 2) {
+        int run = (unsigned char)in[0];
+        memset(page + i, in[1], run);
+        i += run;
+    }
+}
+
+// Restore a page from its compressed pool slot into its frame
+void readPoolPage(int entry, int frame) {
+    if (framePool == NULL) {
+        return;
+    }
+    decompressPage(zswapArea + (size_t)entry * PAGE_SIZE, framePool + (size_t)frame * PAGE_SIZE);
+}
+
+// Write a page from its compressed pool slot back to the swap file
+void writePoolPage(int entry) {
+    if (framePool == NULL) {
+        return;
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    decompressPage(zswapArea + (size_t)entry * PAGE_SIZE, swapArea + (size_t)entry * PAGE_SIZE);
+    simState->stats.pagingNanos += getElapsedNanos(&start);
+    simState->stats.bytesOut += PAGE_SIZE;
+}
+
+// Swap the data in two frames
+void exchangeFrameData(int a, int b) {
+    if (framePool == NULL) {
+        return;
+    }
+    char temp[PAGE_SIZE];
+    memcpy(temp, framePool + (size_t)a * PAGE_SIZE, PAGE_SIZE);
+    memcpy(framePool + (size_t)a * PAGE_SIZE, framePool + (size_t)b * PAGE_SIZE, PAGE_SIZE);
+    memcpy(framePool + (size_t)b * PAGE_SIZE, temp, PAGE_SIZE);
+}
+
+// Read or write a byte of a resident page
+void accessPage(int entry, int offset, int write) {
+    if (framePool == NULL) {
+        return;
+    }
+    char *data = framePool + (size_t)pageTable[entry].frame * PAGE_SIZE + offset;
+    if (write) {
+        *data = (char)entry;
+    } else {
+        dataSink = *data;
+    }
+}
+
+// Give a freed frame's memory back to the kernel, once every frame sharing its host page is free
+void releaseFrame(int frame) {
+    if (framePool == NULL) {
+        return;
+    }
+    int framesPerHostPage = hostPageSize > PAGE_SIZE ? hostPageSize / PAGE_SIZE : 1;
+    int first = frame - frame % framesPerHostPage;
+    for (int f = first; f < first + framesPerHostPage && f < NUM_FRAMES; f++) {
+        if (frameTable[f].occupied == 1) {
+            return;
+        }
+    }
+    if (madvise(framePool + (size_t)first * PAGE_SIZE, (size_t)framesPerHostPage * PAGE_SIZE, MADV_DONTNEED) == -1) {
+        perror("oss: Error: Failed to release frame");
+    }
+}
+
+// Discard a terminated process' swap pages, the next process in its slot starts from zeroes
+void releaseSwap(int index) {
+    if (swapArea == NULL) {
+        return;
+    }
+    char *start = swapArea + (size_t)index * NUM_PAGES_PER_PROCESS * PAGE_SIZE;
+    if (madvise(start, (size_t)NUM_PAGES_PER_PROCESS * PAGE_SIZE, MADV_REMOVE) == -1) {
+        // Not every filesystem can punch holes
+        memset(start, 0, (size_t)NUM_PAGES_PER_PROCESS * PAGE_SIZE);
+    }
+}
+
+// Write every resident page to the swap file and flush it, so the file matches a checkpoint
+void syncBackingStore() {
+    if (framePool == NULL) {
+        return;
+    }
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        for (int frame = processTable[i].residentHead; frame != -1; frame = frameTable[frame].nextResident) {
+            if (pageTable[frameTable[frame].page].dirty) {
+                swapOut(frameTable[frame].page, frame);
+            }
+        }
+    }
+    for (int entry = 0; entry < NUM_PAGES_PER_PROCESS * MAX_PROCESSES; entry++) {
+        if (simState->zswap[entry].stored && simState->zswap[entry].dirty) {
+            writePoolPage(entry);
+        }
+    }
+    if (msync(swapArea, SWAP_SIZE, MS_SYNC) == -1) {
+        perror("oss: Error: Failed to sync swap file");
+    }
+}
+
+// Reload resident and compressed pool pages from the swap file after restoring a checkpoint
+void reloadResidentPages() {
+    if (framePool == NULL) {
+        return;
+    }
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        for (int frame = processTable[i].residentHead; frame != -1; frame = frameTable[frame].nextResident) {
+            memcpy(framePool + (size_t)frame * PAGE_SIZE, swapArea + (size_t)frameTable[frame].page * PAGE_SIZE, PAGE_SIZE);
+        }
+    }
+    for (int entry = 0; entry < NUM_PAGES_PER_PROCESS * MAX_PROCESSES; entry++) {
+        if (simState->zswap[entry].stored) {
+            compressPage(swapArea + (size_t)entry * PAGE_SIZE, zswapArea + (size_t)entry * PAGE_SIZE);
+        }
+    }
+}
+
+/* END BACKING STORE FUNCTIONS */
+
+/* PAGING DEVICE FUNCTIONS */
+
+// Get the device a swap slot is striped onto
+struct Device *getDevice(int entry) {
+    return &simState->devices[(entry / STRIPE_PAGES) % numDevices];
+}
+
+// Get a swap slot's position on its own device, consecutive stripes on a device sit next to each other
+int getDeviceSlot(int entry) {
+    return (entry / (STRIPE_PAGES * numDevices)) * STRIPE_PAGES + entry % STRIPE_PAGES;
+}
+
+// Queue a swap-in for a faulting process, or a write back when index is -1. Returns 0 if the request was dropped.
+int submitIO(int entry, int index, int write) {
+    struct Device *device = getDevice(entry);
+
+    // Write backs nobody waits on are not modeled once the queue is nearly full, faults always fit
+    if (device->queueLength >= IO_QUEUE_SIZE - (write ? MAX_PROCESSES : 0)) {
+        if (write) {
+            return 0;
+        }
+        fprintf(stderr, "oss: Error: Paging device queue is full\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct IORequest *request = &device->queue[device->queueLength++];
+    request->entry = entry;
+    request->index = index;
+    request->write = write;
+    request->arrival = getClockTime();
+    request->deadline = request->arrival + (write ? WRITE_DEADLINE : READ_DEADLINE);
+
+    simState->stats.ioRequests++;
+    if (device->queueLength > simState->stats.maxQueueDepth) {
+        simState->stats.maxQueueDepth = device->queueLength;
+    }
+    return 1;
+}
+
+// Pick which queued request a device services next
+int pickRequest(struct Device *device) {
+    int best = 0;
+    if (ioScheduler == SCHED_FCFS) {
+        return best;
+    }
+
+    // Deadline serves anything that has waited too long first, oldest deadline first
+    if (ioScheduler == SCHED_DEADLINE) {
+        for (int i = 1; i < device->queueLength; i++) {
+            if (device->queue[i].deadline < device->queue[best].deadline) {
+                best = i;
+            }
+        }
+        if (device->queue[best].deadline <= getClockTime()) {
+            return best;
+        }
+    }
+
+    best = -1;
+    for (int i = 0; i < device->queueLength; i++) {
+        int slot = getDeviceSlot(device->queue[i].entry);
+        if (best == -1) {
+            best = i;
+            continue;
+        }
+        int bestSlot = getDeviceSlot(device->queue[best].entry);
+        if (ioScheduler == SCHED_SSTF) {
+            // Shortest seek from the head
+            if (abs(slot - device->headPosition) < abs(bestSlot - device->headPosition)) {
+                best = i;
+            }
+        } else {
+            // Elevator sweeping upward, wrapping to the lowest slot when nothing is ahead of the head
+            int ahead = slot >= device->headPosition;
+            int bestAhead = bestSlot >= device->headPosition;
+            if ((ahead && !bestAhead) || (ahead == bestAhead && slot < bestSlot)) {
+                best = i;
+            }
+        }
+    }
+    return best;
+}
+
+// Remove a request from a device queue, keeping the rest oldest first
+struct IORequest takeRequest(struct Device *device, int i) {
+    struct IORequest request = device->queue[i];
+    memmove(&device->queue[i], &device->queue[i + 1], (device->queueLength - i - 1) * sizeof(struct IORequest));
+    device->queueLength--;
+    return request;
+}
+
+// Start the next transfer on an idle device, merging queued requests for the following slots into it
+void dispatchIO(struct Device *device) {
+    struct IORequest first = takeRequest(device, pickRequest(device));
+    long long start = device->busyUntil > first.arrival ? device->busyUntil : first.arrival;
+
+    // Moving the head costs a seek, reading the next slot does not
+    int distance = abs(getDeviceSlot(first.entry) - device->headPosition);
+    long long serviceTime = IO_OVERHEAD_TIME + IO_TRANSFER_TIME;
+    if (distance > 1) {
+        serviceTime += IO_SEEK_TIME + (long long)distance * IO_SEEK_SLOT_TIME;
+    }
+
+    device->current[0] = first;
+    device->numCurrent = 1;
+    int last = getDeviceSlot(first.entry);
+    for (int i = 0; mergeRequests && i < device->queueLength && device->numCurrent < MAX_MERGE; i++) {
+        struct IORequest *request = &device->queue[i];
+        if (request->write == first.write && getDeviceSlot(request->entry) == last + 1 && request->arrival <= start) {
+            device->current[device->numCurrent++] = takeRequest(device, i);
+            last++;
+            serviceTime += IO_TRANSFER_TIME;
+            simState->stats.ioMerges++;
+
+            // Start over, an earlier request may continue the run
+            i = -1;
+        }
+    }
+
+    device->headPosition = last;
+    device->busyUntil = start + serviceTime;
+    for (int i = 0; i < device->numCurrent; i++) {
+        device->current[i].finish = device->busyUntil;
+    }
+}
+
+// Drop the faults a terminated process was waiting on, a transfer already under way finishes for nobody
+void cancelIO(int index) {
+    for (int d = 0; d < numDevices; d++) {
+        struct Device *device = &simState->devices[d];
+        for (int i = 0; i < device->queueLength; ) {
+            if (device->queue[i].index == index) {
+                takeRequest(device, i);
+            } else {
+                i++;
+            }
+        }
+        for (int i = 0; i < device->numCurrent; i++) {
+            if (device->current[i].index == index) {
+                device->current[i].index = -1;
+            }
+        }
+    }
+}
+
+// Get when the next transfer finishes, -1 if every device is idle
+long long nextDeviceEvent() {
+    long long next = -1;
+    for (int d = 0; d < numDevices; d++) {
+        struct Device *device = &simState->devices[d];
+        if (device->numCurrent > 0 && (next == -1 || device->busyUntil < next)) {
+            next = device->busyUntil;
+        }
+    }
+    return next;
+}
+
+// Get the next request a paging device has finished, returns 0 when none are done yet
+int nextCompletion(struct IORequest *done) {
+    long long now = getClockTime();
+    for (int d = 0; d < numDevices; d++) {
+        struct Device *device = &simState->devices[d];
+        if (device->numCurrent == 0 && device->queueLength > 0) {
+            dispatchIO(device);
+        }
+        if (device->numCurrent > 0 && device->busyUntil <= now) {
+            *done = device->current[--device->numCurrent];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* END PAGING DEVICE FUNCTIONS */
+
+/* ZSWAP FUNCTIONS */
+
+// Compress an evicted page, returns its size or -1 if it does not compress. Data-backed frames are really
+// encoded into the entry's pool slot, otherwise the size comes from the configured ratio.
+int getCompressedSize(int entry, int frame) {
+    if (framePool == NULL) {
+        return (int)(PAGE_SIZE / zswapRatio);
+    }
+    return compressPage(framePool + (size_t)frame * PAGE_SIZE, zswapArea + (size_t)entry * PAGE_SIZE);
+}
+
+// Remove a page from the pool
+void zswapUnlink(int entry) {
+    struct ZswapEntry *slot = &simState->zswap[entry];
+    if (slot->older != -1) {
+        simState->zswap[slot->older].newer = slot->newer;
+    } else {
+        simState->zswapOldest = slot->newer;
+    }
+    if (slot->newer != -1) {
+        simState->zswap[slot->newer].older = slot->older;
+    } else {
+        simState->zswapNewest = slot->older;
+    }
+    simState->zswapUsed -= slot->size;
+    slot->stored = 0;
+    slot->size = 0;
+    slot->dirty = 0;
+    slot->older = -1;
+    slot->newer = -1;
+}
+
+// Push the oldest page out of the pool, writing it to its paging device if the device's copy is stale
+void zswapWriteback() {
+    int entry = simState->zswapOldest;
+    if (simState->zswap[entry].dirty) {
+        writePoolPage(entry);
+        if (submitIO(entry, -1, 1)) {
+            simState->stats.writebacks++;
+        }
+    }
+    zswapUnlink(entry);
+    simState->stats.zswapWritebacks++;
+}
+
+// Compress an evicted page into the pool, making room by pushing out the oldest pages. Returns 0 if the pool is off or the page cannot fit.
+int zswapStore(int entry, int frame, int dirty) {
+    if (zswapSize == 0) {
+        return 0;
+    }
+    int size = getCompressedSize(entry, frame);
+    if (size == -1 || size > zswapSize) {
+        return 0;
+    }
+    while (simState->zswapUsed + size > zswapSize) {
+        zswapWriteback();
+    }
+
+    // Newest pages go at the tail
+    struct ZswapEntry *slot = &simState->zswap[entry];
+    slot->stored = 1;
+    slot->size = size;
+    slot->dirty = dirty;
+    slot->older = simState->zswapNewest;
+    slot->newer = -1;
+    if (simState->zswapNewest != -1) {
+        simState->zswap[simState->zswapNewest].newer = entry;
+    } else {
+        simState->zswapOldest = entry;
+    }
+    simState->zswapNewest = entry;
+    simState->zswapUsed += size;
+
+    advanceClock(ZSWAP_COMPRESS_TIME);
+    simState->stats.zswapStores++;
+    return 1;
+}
+
+// Take a faulting page out of the pool, returns 1 if it was there along with whether its paging device copy is stale
+int zswapLoad(int entry, int *dirty) {
+    if (!simState->zswap[entry].stored) {
+        return 0;
+    }
+    *dirty = simState->zswap[entry].dirty;
+    zswapUnlink(entry);
+    advanceClock(ZSWAP_DECOMPRESS_TIME);
+    simState->stats.zswapHits++;
+    return 1;
+}
+
+/* END ZSWAP FUNCTIONS */
+
+/* MEMORY FUNCTIONS */
+
+// Get the process table index of a pid
+int getProcessIndex(pid_t pid) {
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        if (processTable[i].occupied == 1 && processTable[i].pid == pid) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Get the page table entry for an address, each process owns the block of entries at its process table index
+int getPageTableEntry(pid_t pid, int address) {
+    int index = getProcessIndex(pid);
+    if (index == -1) {
+        perror("oss: Error: Failed to find process for page table entry");
+        exit(EXIT_FAILURE);
+    }
+    return index * NUM_PAGES_PER_PROCESS + address / PAGE_SIZE;
+}
+
+// Get the first page table entry of the huge page region holding an entry
+int getRegionStart(int entry) {
+    return entry - entry % hugePageFrames;
+}
+
+// Check whether a TLB entry covers a page table entry
+int tlbCovers(struct TLBEntry *tlbEntry, int entry) {
+    int span = tlbEntry->huge ? hugePageFrames : 1;
+    return tlbEntry->valid && entry >= tlbEntry->entry && entry < tlbEntry->entry + span;
+}
+
+// Look up a page in the TLB, returns 1 on a hit
+int tlbLookup(int entry) {
+    for (int i = 0; i < TLB_ENTRIES; i++) {
+        if (tlbCovers(&simState->tlb[i], entry)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Add a page to the TLB, one entry covers the whole huge page if it is part of one
+void tlbInsert(int entry) {
+    struct TLBEntry *tlbEntry = &simState->tlb[simState->tlbNext];
+    tlbEntry->valid = 1;
+    tlbEntry->huge = pageTable[entry].huge;
+    tlbEntry->entry = tlbEntry->huge ? getRegionStart(entry) : entry;
+    simState->tlbNext = (simState->tlbNext + 1) % TLB_ENTRIES;
+}
+
+// Drop any TLB entry covering a page
+void tlbInvalidate(int entry) {
+    for (int i = 0; i < TLB_ENTRIES; i++) {
+        if (tlbCovers(&simState->tlb[i], entry)) {
+            simState->tlb[i].valid = 0;
+        }
+    }
+}
+
+// Add a frame to its owner's resident list
+void linkResident(int frame) {
+    struct PCB *owner = &processTable[frameTable[frame].page / NUM_PAGES_PER_PROCESS];
+    frameTable[frame].prevResident = -1;
+    frameTable[frame].nextResident = owner->residentHead;
+    if (owner->residentHead != -1) {
+        frameTable[owner->residentHead].prevResident = frame;
+    }
+    owner->residentHead = frame;
+    owner->residentCount++;
+}
+
+// Remove a frame from its owner's resident list
+void unlinkResident(int frame) {
+    struct PCB *owner = &processTable[frameTable[frame].page / NUM_PAGES_PER_PROCESS];
+    if (frameTable[frame].prevResident != -1) {
+        frameTable[frameTable[frame].prevResident].nextResident = frameTable[frame].nextResident;
+    } else {
+        owner->residentHead = frameTable[frame].nextResident;
+    }
+    if (frameTable[frame].nextResident != -1) {
+        frameTable[frameTable[frame].nextResident].prevResident = frameTable[frame].prevResident;
+    }
+    frameTable[frame].nextResident = -1;
+    frameTable[frame].prevResident = -1;
+    owner->residentCount--;
+}
+
+// Add a free frame to the free list
+void linkFree(int frame) {
+    frameTable[frame].prevResident = -1;
+    frameTable[frame].nextResident = simState->freeHead;
+    if (simState->freeHead != -1) {
+        frameTable[simState->freeHead].prevResident = frame;
+    }
+    simState->freeHead = frame;
+}
+
+// Remove a frame from the free list
+void unlinkFree(int frame) {
+    if (frameTable[frame].prevResident != -1) {
+        frameTable[frameTable[frame].prevResident].nextResident = frameTable[frame].nextResident;
+    } else {
+        simState->freeHead = frameTable[frame].nextResident;
+    }
+    if (frameTable[frame].nextResident != -1) {
+        frameTable[frameTable[frame].nextResident].prevResident = frameTable[frame].prevResident;
+    }
+    frameTable[frame].nextResident = -1;
+    frameTable[frame].prevResident = -1;
+}
+
+// Clear a frame's contents and reverse map
+void clearFrame(int frame) {
+    frameTable[frame].occupied = 0;
+    frameTable[frame].page = -1;
+    frameTable[frame].dirty = 0;
+    frameTable[frame].valid = 1;
+}
+
+// Split a huge page back into base pages
+void demoteRegion(int start) {
+    tlbInvalidate(start);
+    for (int i = start; i < start + hugePageFrames; i++) {
+        pageTable[i].huge = 0;
+    }
+    simState->stats.demotions++;
+}
+
+// Evict the page in a frame, splitting its huge page first
+void evictFrame(int frame) {
+    int entry = frameTable[frame].page;
+    if (entry != -1) {
+        if (pageTable[entry].huge) {
+            demoteRegion(getRegionStart(entry));
+        }
+        tlbInvalidate(entry);
+
+        // Compress the page into the pool, otherwise write it back if it was changed.
+        // A changed page in the pool only reaches the swap file when the pool pushes it out.
+        int dirty = pageTable[entry].dirty;
+        if (!zswapStore(entry, frame, dirty) && dirty) {
+            swapOut(entry, frame);
+            if (submitIO(entry, -1, 1)) {
+                simState->stats.writebacks++;
+            }
+        }
+
+        unlinkResident(frame);
+        pageTable[entry].frame = -1;
+        pageTable[entry].dirty = 0;
+        pageTable[entry].referenced = 0;
+        simState->stats.evictions++;
+        clearFrame(frame);
+        linkFree(frame);
+    }
+}
+
+// Allocate a frame off the free list, evicting the head of the FIFO queue if none are free
+int allocateFrame() {
+    int frame = simState->freeHead;
+    if (frame != -1) {
+        unlinkFree(frame);
+        return frame;
+    }
+
+    frame = getFrameTableEntryByHeadOfQueue();
+    evictFrame(frame);
+    unlinkFree(frame);
+
+    // Move head of queue to the next frame
+    frameTable[frame].headOfQueue = 0;
+    simState->fifoHead = (frame + 1) % numFrames;
+    frameTable[simState->fifoHead].headOfQueue = 1;
+    return frame;
+}
+
+// Map a page into a frame
+void mapPage(int entry, int frame) {
+    frameTable[frame].occupied = 1;
+    frameTable[frame].page = entry;
+    frameTable[frame].dirty = 0;
+    frameTable[frame].valid = 1;
+    pageTable[entry].frame = frame;
+    linkResident(frame);
+}
+
+// Free every resident page of a process by walking its resident list, then reset its block of the page table
+void freeProcessPages(int index) {
+    int frame = processTable[index].residentHead;
+    while (frame != -1) {
+        int next = frameTable[frame].nextResident;
+        clearFrame(frame);
+        linkFree(frame);
+        releaseFrame(frame);
+        frame = next;
+    }
+    processTable[index].residentHead = -1;
+    processTable[index].residentCount = 0;
+
+    for (int i = index * NUM_PAGES_PER_PROCESS; i < (index + 1) * NUM_PAGES_PER_PROCESS; i++) {
+        tlbInvalidate(i);
+        if (simState->zswap[i].stored) {
+            zswapUnlink(i);
+        }
+        pageTable[i].pid = -1;
+        pageTable[i].frame = -1;
+        pageTable[i].dirty = 0;
+        pageTable[i].valid = 1;
+        pageTable[i].referenced = 0;
+        pageTable[i].huge = 0;
+    }
+}
+
+// Swap the contents of two frames, either may be free. The FIFO head stays where it is.
+void exchangeFrames(int a, int b) {
+    // Take both frames off their resident or free lists while their contents move
+    if (frameTable[a].page != -1) {
+        unlinkResident(a);
+    } else {
+        unlinkFree(a);
+    }
+    if (frameTable[b].page != -1) {
+        unlinkResident(b);
+    } else {
+        unlinkFree(b);
+    }
+
+    struct FrameTable temp = frameTable[a];
+    frameTable[a].occupied = frameTable[b].occupied;
+    frameTable[a].page = frameTable[b].page;
+    frameTable[a].dirty = frameTable[b].dirty;
+    frameTable[a].valid = frameTable[b].valid;
+    frameTable[b].occupied = temp.occupied;
+    frameTable[b].page = temp.page;
+    frameTable[b].dirty = temp.dirty;
+    frameTable[b].valid = temp.valid;
+
+    // Point the page table entries at their new frames
+    if (frameTable[a].page != -1) {
+        pageTable[frameTable[a].page].frame = a;
+        linkResident(a);
+    } else {
+        linkFree(a);
+    }
+    if (frameTable[b].page != -1) {
+        pageTable[frameTable[b].page].frame = b;
+        linkResident(b);
+    } else {
+        linkFree(b);
+    }
+
+    // Copy the frame, simulating the time spent
+    exchangeFrameData(a, b);
+    advanceClock(PAGE_MIGRATE_TIME);
+}
+
+// Promote a fully resident region to a huge page, compacting it into aligned contiguous frames
+void promoteRegion(int start) {
+    // Pick the aligned block that needs the fewest evictions, never breaking up another huge page
+    int target = -1;
+    int targetCost = hugePageFrames + 1;
+    for (int block = 0; block + hugePageFrames <= numFrames; block += hugePageFrames) {
+        int cost = 0;
+        for (int f = block; f < block + hugePageFrames && cost < targetCost; f++) {
+            int entry = frameTable[f].page;
+            if (frameTable[f].occupied == 0 || entry == -1 || (entry >= start && entry < start + hugePageFrames)) {
+                continue;
+            }
+            cost = pageTable[entry].huge ? targetCost : cost + 1;
+        }
+        if (cost < targetCost) {
+            target = block;
+            targetCost = cost;
+        }
+    }
+    if (target == -1) {
+        return;
+    }
+
+    // Make room, then move each page to its place in the block
+    for (int f = target; f < target + hugePageFrames; f++) {
+        int entry = frameTable[f].page;
+        if (frameTable[f].occupied == 1 && entry != -1 && (entry < start || entry >= start + hugePageFrames)) {
+            evictFrame(f);
+        }
+    }
+    for (int i = 0; i < hugePageFrames; i++) {
+        if (pageTable[start + i].frame != target + i) {
+            exchangeFrames(pageTable[start + i].frame, target + i);
+        }
+    }
+
+    // Replace the base page TLB entries with one for the huge page
+    for (int i = start; i < start + hugePageFrames; i++) {
+        tlbInvalidate(i);
+        pageTable[i].huge = 1;
+    }
+    simState->stats.promotions++;
+}
+
+// Promote a page's region once the process has touched every page in it
+void checkPromotion(int entry) {
+    if (hugePageFrames == 1 || pageTable[entry].huge) {
+        return;
+    }
+
+    int start = getRegionStart(entry);
+    for (int i = start; i < start + hugePageFrames; i++) {
+        if (pageTable[i].frame == -1 || pageTable[i].referenced == 0) {
+            return;
+        }
+    }
+    promoteRegion(start);
+}
+
+/* END MEMORY FUNCTIONS */
+
+/* STATS FUNCTIONS */
+
+// Log a one line summary of the run, as key=value pairs so it can be parsed by sweep
+void logSummary(const char* logfile) {
+    struct Stats *stats = &simState->stats;
+    char summary[768];
+    double faultRate = stats->references > 0 ? 100.0 * stats->pageFaults / stats->references : 0.0;
+    double tlbHitRate = stats->references > 0 ? 100.0 * stats->tlbHits / stats->references : 0.0;
+    double pagingMBps = stats->pagingNanos > 0 ? (stats->bytesIn + stats->bytesOut) * 1000.0 / stats->pagingNanos : 0.0;
+    double avgFaultMs = stats->faultsServiced > 0 ? stats->faultLatency / 1000000.0 / stats->faultsServiced : 0.0;
+    sprintf(summary, "OSS: Summary: time=%u.%09u wallSec=%.3f launched=%d references=%lu reads=%lu writes=%lu faults=%lu faultRate=%.2f evictions=%lu tlbHitRate=%.2f promotions=%lu demotions=%lu writebacks=%lu swapInKB=%llu swapOutKB=%llu pagingMBps=%.1f ioRequests=%lu ioMerges=%lu maxQueue=%d avgFaultMs=%.2f maxFaultMs=%.2f zswapStores=%lu zswapHits=%lu zswapWritebacks=%lu\n",
+        sysClock->seconds, sysClock->nanoseconds, getElapsedNanos(&startTime) / 1e9, simState->numLaunchedProcesses, stats->references, stats->reads, stats->writes, stats->pageFaults, faultRate, stats->evictions,
+        tlbHitRate, stats->promotions, stats->demotions, stats->writebacks, stats->bytesIn / 1024, stats->bytesOut / 1024, pagingMBps,
+        stats->ioRequests, stats->ioMerges, stats->maxQueueDepth, avgFaultMs, stats->maxFaultLatency / 1000000.0,
+        stats->zswapStores, stats->zswapHits, stats->zswapWritebacks);
+    writeLog(logfile, summary);
+}
+
+// Publish live counters to the telemetry page, plain stores inside a seqlock
+void publishTelemetry() {
+    // Frame and queue totals come from the resident and device counts, not a frame table scan
+    int resident = 0, blocked = 0, queueDepth = 0;
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        resident += processTable[i].residentCount;
+        blocked += processTable[i].blocked;
+    }
+    for (int d = 0; d < numDevices; d++) {
+        queueDepth += simState->devices[d].queueLength + simState->devices[d].numCurrent;
+    }
+
+    telemetry->seq++;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    telemetry->seconds = sysClock->seconds;
+    telemetry->nanoseconds = sysClock->nanoseconds;
+    telemetry->activeProcesses = simState->numActiveProcesses;
+    telemetry->blockedProcesses = blocked;
+    telemetry->launchedProcesses = simState->numLaunchedProcesses;
+    telemetry->numFrames = numFrames;
+    telemetry->freeFrames = numFrames - resident;
+    telemetry->queueDepth = queueDepth;
+    telemetry->references = simState->stats.references;
+    telemetry->pageFaults = simState->stats.pageFaults;
+    telemetry->evictions = simState->stats.evictions;
+    telemetry->writebacks = simState->stats.writebacks;
+    telemetry->tlbHits = simState->stats.tlbHits;
+    telemetry->zswapUsed = simState->zswapUsed;
+    telemetry->zswapHits = simState->stats.zswapHits;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    telemetry->seq++;
+}
+
+/* END STATS FUNCTIONS */
+
 /* CLEANUP FUNCTIONS */
 
 // Cleanup shared memory
@@ -209,16 +1547,42 @@ void cleanupMessageQueue() {
     }
 }
 
-// Cleanup page table
-void cleanupPageTable() {
-    // Free page table
-    free(pageTable);
+// Cleanup simulation state
+void cleanupSimState() {
+    // Unmap simulation state, which holds the page and frame tables
+    munmap(simState, sizeof(struct SimState));
+}
+
+// Cleanup frame pool and swap file
+void cleanupBackingStore() {
+    if (framePool == NULL) {
+        return;
+    }
+    msync(swapArea, SWAP_SIZE, MS_ASYNC);
+    munmap(swapArea, SWAP_SIZE);
+    munmap(zswapArea, SWAP_SIZE);
+    munmap(framePool, (size_t)NUM_FRAMES * PAGE_SIZE);
+}
+
+// Cleanup telemetry page
+void cleanupTelemetry() {
+    // Let ossstat know we are done, it keeps its mapping after the unlink
+    telemetry->finished = 1;
+    munmap(telemetry, sizeof(struct Telemetry));
+    shm_unlink(telemetryName);
 }
 
-// Cleanup frame table
-void cleanupFrameTable() {
-    // Free frame table
-    free(frameTable);
+// Cleanup worker pool
+void cleanupWorkerPool() {
+    // Parked workers would exit once the message queue is gone, but do not leave them behind
+    for (int i = 0; i < numWorkers; i++) {
+        if (workerPids[i] == -1) {
+            continue;
+        }
+        kill(workerPids[i], SIGTERM);
+        waitpid(workerPids[i], NULL, 0);
+    }
+    numWorkers = 0;
 }
 
 /* END CLEANUP FUNCTIONS */
@@ -227,20 +1591,19 @@ void cleanupFrameTable() {
 
 // Main
 int main(int argc, char *argv[]) {
-    // Seed random number generator
-    srand(time(NULL));
-
     /* INITIALIZE */
 
     initSharedMemory();
     initSystemClock();
     initMessageQueue();
+    initSimState();
     initProcessTable();
     initPageTable();
     initFrameTable();
 
     // Set last output time
     clock_gettime(CLOCK_MONOTONIC, &lastOutputTime);
+    startTime = lastOutputTime;
     unsigned int nextOutputTime = (lastOutputTime.tv_sec * 1000000000 + lastOutputTime.tv_nsec);
 
     // Init signal handlers
@@ -255,13 +1618,14 @@ int main(int argc, char *argv[]) {
     int n = -1; // number of processes
 	int s = -1; // max simultaneous processes 
 	char* logfile = NULL;
+	char* restoreFile = NULL;
 
 	// Parse command line arguments
 	int opt;
-	while ((opt = getopt(argc, argv, "hn:s:t:f:")) != -1) {
+	while ((opt = getopt(argc, argv, "hn:s:t:f:c:r:m:w:l:p:d:D:q:g:k:z:Z:")) != -1) {
 		switch(opt) {
 			case 'h':
-				printf("Usage: %s [-h] [-n num procs] [-s max simul procs] [-f logfile]\n", argv[0]);
+				printf("Usage: %s [-h] [-n num procs] [-s max simul procs] [-f logfile] [-c checkpoint out] [-r checkpoint in] [-m num frames] [-w write percent] [-l process lifetime] [-p frames per huge page] [-d swap file] [-D num devices] [-q fcfs|sstf|deadline] [-g merge 0|1] [-k worker pool 0|1] [-z zswap KB] [-Z zswap ratio]\n", argv[0]);
 				exit(0);
 			case 'n':
 				n = atoi(optarg);
@@ -272,6 +1636,54 @@ int main(int argc, char *argv[]) {
 			case 'f':
 				logfile = optarg;
 				break;
+			case 'c':
+				checkpointFile = optarg;
+				break;
+			case 'r':
+				restoreFile = optarg;
+				break;
+			case 'm':
+				numFrames = atoi(optarg);
+				break;
+			case 'w':
+				writePercent = atoi(optarg);
+				break;
+			case 'l':
+				lifetime = atoi(optarg);
+				break;
+			case 'p':
+				hugePageFrames = atoi(optarg);
+				break;
+			case 'd':
+				swapFile = optarg;
+				break;
+			case 'D':
+				numDevices = atoi(optarg);
+				break;
+			case 'q':
+				if (strcmp(optarg, "fcfs") == 0) {
+					ioScheduler = SCHED_FCFS;
+				} else if (strcmp(optarg, "sstf") == 0) {
+					ioScheduler = SCHED_SSTF;
+				} else if (strcmp(optarg, "deadline") == 0) {
+					ioScheduler = SCHED_DEADLINE;
+				} else {
+					fprintf(stderr, "Error: Unknown scheduler %s.\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'g':
+				mergeRequests = atoi(optarg);
+				break;
+			case 'k':
+				usePool = atoi(optarg);
+				break;
+			case 'z':
+				zswapSize = atoi(optarg) * 1024;
+				break;
+			case 'Z':
+				zswapRatio = atof(optarg);
+				break;
 		}
 	}
 
@@ -285,11 +1697,18 @@ int main(int argc, char *argv[]) {
 	if (!logfile) {
 		fprintf(stderr, "Error: No logfile specified.\n");
 		exit(1);
-	} else if (n < 1 || s < 1 || s > 20) {
+	} else if (n < 1 || s < 1 || s > 20 || numFrames < 1 || numFrames > NUM_FRAMES || writePercent < 0 || writePercent > 100 || lifetime < 0
+			|| hugePageFrames < 1 || hugePageFrames > MAX_HUGE_PAGE_FRAMES || NUM_PAGES_PER_PROCESS % hugePageFrames != 0 || hugePageFrames > numFrames
+			|| numDevices < 1 || numDevices > MAX_DEVICES || zswapSize < 0 || zswapSize > (int)SWAP_SIZE || zswapRatio < 1) {
 		fprintf(stderr, "Error: Invalid arguments.\n");
 		exit(1);
 	}
 
+    simState->numFrames = numFrames;
+    simState->hugePageFrames = hugePageFrames;
+    simState->numDevices = numDevices;
+    initFreeList();
+
     /* END ARGUMENTS */
 
     /* INIT LOGFILE */
@@ -298,138 +1717,91 @@ int main(int argc, char *argv[]) {
 
     /* END INIT LOGFILE */
 
-    /* VARIABLES */
+    /* RESTORE CHECKPOINT */
 
-    int numActiveProcesses = 0; // Number of active processes
-    int numLaunchedProcesses = 0; // Number of launched processes
+    if (restoreFile) {
+        restoreCheckpoint(restoreFile);
 
-    /* MAIN LOOP */   
+        // The path can be longer than logMessage holds
+        char restoreMessage[PATH_MAX + 100];
+        snprintf(restoreMessage, sizeof(restoreMessage), "OSS: Restored checkpoint %s at time %d:%d, replaying %d children\n", restoreFile, sysClock->seconds, sysClock->nanoseconds, simState->numActiveProcesses);
+        writeLog(logfile, restoreMessage);
+    }
 
-    while (numActiveProcesses > 0 || (numLaunchedProcesses < n && numLaunchedProcesses <= 100)) {
+    /* END RESTORE CHECKPOINT */
 
-        // Check if any processes have terminated
-        int status;
-        int termPid = waitpid(-1, &status, WNOHANG);
-        if (termPid > 0 ) {
-            // Free up its resources and log its termination
-            for (int i = 0; i < MAX_PROCESSES; i++) {
-                if (processTable[i].pid == termPid) {
-                    // Free up its resources
-                    for (int j = 0; j < NUM_PAGES_PER_PROCESS * MAX_PROCESSES; j++) {
-                        if (pageTable[j].pid == termPid) {
-                            // Update page table entry and frame table entry
-                            frameTable[pageTable[j].frame].occupied = 0;
-                            frameTable[pageTable[j].frame].page = -1;
-                            frameTable[pageTable[j].frame].dirty = 0;
-                            frameTable[pageTable[j].frame].valid = 1;
-                            pageTable[j].pid = -1;
-                            pageTable[j].frame = -1;
-                            pageTable[j].dirty = 0;
-                            pageTable[j].valid = 1;
-                            pageTable[j].referenced = 0;
-                        }
-                    }
-                    for (int j = 0; j < MAX_PROCESSES; j++) {
-                        if (processTable[j].pid == termPid) {
-                            // Update PCB
-                            processTable[j].occupied = 0;
-                            processTable[j].pid = -1;
-                            processTable[j].eventWaitSec = 0;
-                            processTable[j].eventWaitNano = 0;
-                            processTable[j].blocked = 0;
-                        }
-                    }
+    /* INIT BACKING STORE */
 
-                    // Log its termination
-                    sprintf(logMessage, "OSS: Child %d terminated at time %d:%d\n", inbox.mData.pid, sysClock->seconds, sysClock->nanoseconds);
-                    writeLog(logfile, logMessage);
-                }
-            }
+    if (swapFile) {
+        initBackingStore(restoreFile != NULL);
+        if (restoreFile) {
+            reloadResidentPages();
         }
+    }
 
-        // Determine if a new process should be launched
-        if (numActiveProcesses < s && numActiveProcesses < MAX_PROCESSES && numLaunchedProcesses < n && numLaunchedProcesses <= 100) {
-            // Launch a new process
-            pid_t pid = fork();
+    /* END INIT BACKING STORE */
 
-            // Child process code
-            if (pid == 0) { 
-                execl("./user_proc", "user_proc", NULL);
-                exit(0);
+    /* INIT TELEMETRY */
 
-            // Parent process code
-            } else if (pid > 0) {
+    initTelemetry();
+    sprintf(logMessage, "OSS: Publishing telemetry for ossstat, run ./ossstat %d\n", getpid());
+    writeLog(logfile, logMessage);
 
-                // Increment number of active processes and launched processes
-                numActiveProcesses++;
-                numLaunchedProcesses++;
+    /* END INIT TELEMETRY */
 
-                // Assign the process its pages (32k of memory, each page is 1k)
-                for (int i = 0; i < NUM_PAGES_PER_PROCESS; i++) {
-                    // Find an empty page table entry
-                    int pageTableEntry = -1;
-                    for (int j = 0; j < NUM_PAGES_PER_PROCESS * MAX_PROCESSES; j++) {
-                        if (pageTable[j].pid == -1) {
-                            pageTableEntry = j;
-
-                            // Update page table entry
-                            pageTable[pageTableEntry].pid = pid;
-                            pageTable[pageTableEntry].frame = -1;
-                            pageTable[pageTableEntry].dirty = 0;
-                            pageTable[pageTableEntry].valid = 1;
-                            pageTable[pageTableEntry].referenced = 1;
-
-                            break;
-                        }
-                    }
+    /* INIT WORKER POOL */
 
-                    // If no empty page table entry was found
-                    if (pageTableEntry == -1) {
-                        perror("oss: Error: Failed to find empty page table entry");
-                        // Output page table
-                        printf("OSS: Page table:\n");
-                        for (int i = 0; i < NUM_PAGES_PER_PROCESS * MAX_PROCESSES; i++) {
-                            printf("OSS: Page table entry %d: pid=%d, frame=%d, dirty=%d, valid=%d, referenced=%d\n", i, pageTable[i].pid, pageTable[i].frame, pageTable[i].dirty, pageTable[i].valid, pageTable[i].referenced);
-                        }
-                        exit(EXIT_FAILURE);
-                    }
+    // One parked worker per process slot, so launching never forks on the main loop
+    if (usePool && !replayMode) {
+        initWorkerPool(s < MAX_PROCESSES ? s : MAX_PROCESSES);
+    }
 
-                    // Find an empty frame table entry
-                    int frameTableEntry = getFrameTableEntryByHeadOfQueue();
-
-                    // Update frame table entry
-                    frameTable[frameTableEntry].occupied = 1;
-                    frameTable[frameTableEntry].page = -1;
-                    frameTable[frameTableEntry].dirty = 0;
-                    frameTable[frameTableEntry].valid = 1;
-                    frameTable[frameTableEntry].headOfQueue = 0;
-
-                    // Move head of queue to the next frame
-                    frameTable[(frameTableEntry + 1) % NUM_FRAMES].headOfQueue = 1;
-
-                    // If no empty frame table entry was found
-                    if (frameTableEntry == -1) {
-                        perror("oss: Error: Failed to find empty frame table entry");
-                        // Output frame table
-                        printf("OSS: Frame table:\n");
-                        for (int i = 0; i < NUM_FRAMES; i++) {
-                            printf("OSS: Frame table entry %d: occupied=%d, page=%d, dirty=%d, valid=%d, headOfQueue=%d\n", i, frameTable[i].occupied, frameTable[i].page, frameTable[i].dirty, frameTable[i].valid, frameTable[i].headOfQueue);
-                        }
-                        exit(EXIT_FAILURE);
-                    }
+    /* END INIT WORKER POOL */
+
+    /* MAIN LOOP */   
 
-                    // Update page table entry and frame table entry to point to each other
-                    pageTable[pageTableEntry].frame = frameTableEntry;
-                    frameTable[frameTableEntry].page = pageTableEntry;
+    while (!stopSignal && (simState->numActiveProcesses > 0 || (simState->numLaunchedProcesses < n && simState->numLaunchedProcesses <= 100))) {
 
-                    // Simulate time spent swapping in the page
-                    advanceClock(14000000);
+        // Check if any processes have terminated
+        int termPid = reapChild();
+        if (termPid > 0 ) {
+            // Free up its resources and log its termination
+            int index = getProcessIndex(termPid);
+            if (index != -1) {
+                // Free up its resources, only touching its own pages
+                cancelIO(index);
+                freeProcessPages(index);
+                releaseSwap(index);
+
+                // Update PCB
+                processTable[index].occupied = 0;
+                processTable[index].pid = -1;
+                processTable[index].eventWaitSec = 0;
+                processTable[index].eventWaitNano = 0;
+                processTable[index].neededPage = -1;
+                processTable[index].blocked = 0;
+                simState->numActiveProcesses--;
+
+                // Log its termination
+                sprintf(logMessage, "OSS: Child %d terminated at time %d:%d\n", termPid, sysClock->seconds, sysClock->nanoseconds);
+                writeLog(logfile, logMessage);
+            }
+        }
 
+        // Determine if a new process should be launched
+        if (simState->numActiveProcesses < s && simState->numActiveProcesses < MAX_PROCESSES && simState->numLaunchedProcesses < n && simState->numLaunchedProcesses <= 100) {
+            // Launch a new process
+            pid_t pid = launchChild();
 
-                }
+            // Parent process code
+            if (pid > 0) {
 
+                // Increment number of active processes and launched processes
+                simState->numActiveProcesses++;
+                simState->numLaunchedProcesses++;
 
                 // Add process to PCB
+                int index = -1;
                 for (int i = 0; i < MAX_PROCESSES; i++) {
                     if (processTable[i].occupied == 0) {
                         processTable[i].occupied = 1;
@@ -437,6 +1809,9 @@ int main(int argc, char *argv[]) {
                         processTable[i].eventWaitSec = 0;
                         processTable[i].eventWaitNano = 0;
                         processTable[i].blocked = 0;
+                        processTable[i].residentHead = -1;
+                        processTable[i].residentCount = 0;
+                        index = i;
                         break;
                     }
                     // If no empty PCB entry was found
@@ -446,95 +1821,83 @@ int main(int argc, char *argv[]) {
                     }
                 }
 
+                // Assign the process its pages (32k of memory, each page is 1k) from its block of the page table.
+                // Pages start out swapped out and are faulted in through the paging devices on first touch.
+                for (int i = 0; i < NUM_PAGES_PER_PROCESS; i++) {
+                    int pageTableEntry = index * NUM_PAGES_PER_PROCESS + i;
+
+                    // Update page table entry
+                    pageTable[pageTableEntry].pid = pid;
+                    pageTable[pageTableEntry].frame = -1;
+                    pageTable[pageTableEntry].dirty = 0;
+                    pageTable[pageTableEntry].valid = 1;
+                    pageTable[pageTableEntry].referenced = 0;
+                    pageTable[pageTableEntry].huge = 0;
+                }
+
             // Error
             } else {
-                perror("oss: Error: Failed to fork");
+                perror("oss: Error: Failed to launch child");
                 exit(EXIT_FAILURE);
             }
         }
 
-        // Check if a process is waiting for an event. If so, check if the event has happened. If so, swap in the page and send a message back to the child.
-        for (int i = 0; i < MAX_PROCESSES; i++) {
-            if (processTable[i].blocked == 1) {
-                // Check if the event has happened
-                if (processTable[i].eventWaitSec * 1000000000 + processTable[i].eventWaitNano + 30000000 <= getClockTime()) {
-
-                    int page = processTable[i].neededPage;
-
-                    // Determine if there is an empty frame
-                    int emptyFrame = -1;
-                    for (int i = 0; i < NUM_FRAMES; i++) {
-                        if (frameTable[i].occupied == 0) {
-                            emptyFrame = i;
-                            break;
-                        }
-                    }
-
-                    // If there is an empty frame
-                    if (emptyFrame != -1) {
-
-                        // Update page table entry
-                        pageTable[page].frame = emptyFrame;
-
-                        // Update frame table entry
-                        frameTable[emptyFrame].page = page;
-                        frameTable[emptyFrame].headOfQueue = 1;
-
-                        // Send message back to child
-                        outbox.mType = inbox.mData.pid;
-                        if (msgsnd(msqid, &outbox, sizeof(outbox.mData), 0) == -1) {
-                            perror("oss: Error: Failed to send message to child");
-                            exit(EXIT_FAILURE);
-                        }
-
-                    // If there is not an empty frame
-                    } else {
-                        // Find the frame table entry
-                        int frameTableEntry = getFrameTableEntryByHeadOfQueue();
-
-                        // If no frame table entry was found
-                        if (frameTableEntry == -1) {
-                            perror("oss: Error: Failed to find frame table entry");
-                            exit(EXIT_FAILURE);
-                        }
-
-                        // Update page table entry
-                        pageTable[frameTable[frameTableEntry].page].frame = -1;
-
-                        // Update frame table entry
-                        frameTable[frameTableEntry].page = page;
-                        frameTable[frameTableEntry].headOfQueue = 1;
-
-                        // Send message back to child
-                        outbox.mType = inbox.mData.pid;
-                        if (msgsnd(msqid, &outbox, sizeof(outbox.mData), 0) == -1) {
-                            perror("oss: Error: Failed to send message to child");
-                            exit(EXIT_FAILURE);
-                        }
-                    }
+        // Check if the paging devices have finished any swap-ins. If so, map the page and send a message back to the child.
+        struct IORequest done;
+        while (nextCompletion(&done)) {
+            // Nobody waits on a write back or a cancelled fault
+            int i = done.index;
+            if (i == -1 || processTable[i].blocked == 0 || processTable[i].neededPage != done.entry) {
+                continue;
+            }
 
+            // Swap the page into a free frame, or evict the head of the FIFO queue
+            int frame = allocateFrame();
+            mapPage(processTable[i].neededPage, frame);
+            swapIn(processTable[i].neededPage, frame);
+
+            // Record how long the child waited for the device, however late this loop noticed
+            unsigned long long latency = done.finish - done.arrival;
+            simState->stats.faultsServiced++;
+            simState->stats.faultLatency += latency;
+            if (latency > simState->stats.maxFaultLatency) {
+                simState->stats.maxFaultLatency = latency;
+            }
 
-                    // Send message back to child
-                    outbox.mType = processTable[i].pid;
-                    if (msgsnd(msqid, &outbox, sizeof(outbox.mData), 0) == -1) {
-                        perror("oss: Error: Failed to send message to child");
-                        exit(EXIT_FAILURE);
-                    }
+            // Update PCB
+            processTable[i].blocked = 0;
+            processTable[i].eventWaitSec = 0;
+            processTable[i].eventWaitNano = 0;
+            processTable[i].neededPage = -1;
 
-                    // Update PCB
-                    processTable[i].blocked = 0;
-                    processTable[i].eventWaitSec = 0;
-                    processTable[i].eventWaitNano = 0;
-                    processTable[i].neededPage = -1;
-                }
-            }
+            // Send message back to child
+            replyToChild(processTable[i].pid);
         }
 
         // Check if we have a message from a child. If so, and there is not a page fault, send a message back. If there is a pagefault, set up its waiting for an event.
-        if (msgrcv(msqid, &inbox, sizeof(inbox.mData), 1, IPC_NOWAIT) != -1) {
+        // Every waiting request is handled in one pass, so faults from several children reach the paging devices together.
+        // Requests left behind by a child that was already reaped are dropped.
+        for (int handled = 0; handled < MAX_PROCESSES && receiveRequest(); handled++) {
+            if (getProcessIndex(inbox.mData.pid) == -1) {
+                continue;
+            }
+
+            // Find the page table entry for the address
+            int page = getPageTableEntry(inbox.mData.pid, inbox.mData.address);
+            simState->stats.references++;
+            if (inbox.mData.readWrite == 1) {
+                simState->stats.writes++;
+            } else {
+                simState->stats.reads++;
+            }
 
-            // Extract the page from the message
-            int page = inbox.mData.address / 1024;
+            // Check the TLB before walking the page table
+            int tlbHit = tlbLookup(page);
+            if (tlbHit) {
+                simState->stats.tlbHits++;
+            } else {
+                simState->stats.tlbMisses++;
+            }
 
             // Determine if there is a page fault by checking if the requested page is in a frame
             int pageFault = 0;
@@ -545,19 +1908,20 @@ int main(int argc, char *argv[]) {
 
             // If there is not a page fault
             if (pageFault == 0) {
+                // Cache the translation
+                if (!tlbHit) {
+                    tlbInsert(page);
+                }
+
                 // Check if the message is a read or write
+                accessPage(page, inbox.mData.address % PAGE_SIZE, inbox.mData.readWrite);
                 if (inbox.mData.readWrite == 1) {
                     // Set dirty bit
-                    for (int i = 0; i < NUM_PAGES_PER_PROCESS * MAX_PROCESSES; i++) {
-                        if (pageTable[i].pid == inbox.mData.pid && pageTable[i].valid == 1 && pageTable[i].frame != -1) {
-                            pageTable[i].dirty = 1;
-
-                            // Add 20ms to simulated clock to simulate write time
-                            advanceClock(20000000);
+                    pageTable[page].dirty = 1;
+                    frameTable[pageTable[page].frame].dirty = 1;
 
-                            break;
-                        }
-                    }
+                    // Add 20ms to simulated clock to simulate write time
+                    advanceClock(20000000);
                 }
                 else {
                     // Add 5ms to simulated clock to simulate read time
@@ -567,30 +1931,46 @@ int main(int argc, char *argv[]) {
                 // Update page table entry
                 pageTable[page].referenced = 1;
 
+                // Promote to a huge page if the process has touched the whole region
+                checkPromotion(page);
+
 
                 // Send message back to child
-                outbox.mType = inbox.mData.pid;
-                if (msgsnd(msqid, &outbox, sizeof(outbox.mData), 0) == -1) {
-                    perror("oss: Error: Failed to send message to child");
-                    exit(EXIT_FAILURE);
-                }
+                replyToChild(inbox.mData.pid);
 
             // If there is a page fault, swap in the page
             } else {
-                // Set up its waiting for an event
-                for (int i = 0; i < MAX_PROCESSES; i++) {
-                    if (processTable[i].pid == inbox.mType) {
-                        processTable[i].blocked = 1;
-                        processTable[i].eventWaitSec = sysClock->seconds;
-                        processTable[i].eventWaitNano = sysClock->nanoseconds + 14000000;
-                        processTable[i].neededPage = page;
-                        break;
+                simState->stats.pageFaults++;
+
+                // Restore the page from the compressed pool if it is there, without going to the paging device
+                int dirty;
+                long long faultTime = getClockTime();
+                if (zswapLoad(page, &dirty)) {
+                    int frame = allocateFrame();
+                    mapPage(page, frame);
+                    readPoolPage(page, frame);
+                    pageTable[page].dirty = dirty;
+                    frameTable[frame].dirty = dirty;
+
+                    // Latency covers the decompress and any compress the eviction for the frame needed
+                    unsigned long long latency = getClockTime() - faultTime;
+                    simState->stats.faultsServiced++;
+                    simState->stats.faultLatency += latency;
+                    if (latency > simState->stats.maxFaultLatency) {
+                        simState->stats.maxFaultLatency = latency;
                     }
+                    replyToChild(inbox.mData.pid);
+                } else {
+                    prefetchPage(page);
+
+                    // Set up its waiting for the paging device to swap the page in
+                    int i = getProcessIndex(inbox.mData.pid);
+                    processTable[i].blocked = 1;
+                    processTable[i].eventWaitSec = sysClock->seconds;
+                    processTable[i].eventWaitNano = sysClock->nanoseconds;
+                    processTable[i].neededPage = page;
+                    submitIO(page, i, 0);
                 }
-
-            // Advance simulated clock 14ms
-            advanceClock(10000000);
-
             }
         }
 
@@ -618,7 +1998,7 @@ int main(int argc, char *argv[]) {
             for (int i = 0; i < NUM_PAGES_PER_PROCESS * MAX_PROCESSES; i++) {
                 if (pageTable[i].pid != -1) {
                     char pageTableEntryString[256];
-                    sprintf(pageTableEntryString, "OSS: Page table entry %d: pid=%d, frame=%d, dirty=%d, valid=%d, referenced=%d\n", i, pageTable[i].pid, pageTable[i].frame, pageTable[i].dirty, pageTable[i].valid, pageTable[i].referenced);
+                    sprintf(pageTableEntryString, "OSS: Page table entry %d: pid=%d, frame=%d, dirty=%d, valid=%d, referenced=%d, huge=%d\n", i, pageTable[i].pid, pageTable[i].frame, pageTable[i].dirty, pageTable[i].valid, pageTable[i].referenced, pageTable[i].huge);
                     strcat(pageTableString, pageTableEntryString);
                 }   
             }
@@ -638,7 +2018,7 @@ int main(int argc, char *argv[]) {
             for (int i = 0; i < NUM_FRAMES; i++) {
                 if (frameTable[i].occupied == 1) {
                     char frameTableEntryString[256];
-                    sprintf(frameTableEntryString, "OSS: Frame table entry %d: occupied=%d, page=%d, dirty=%d, valid=%d, headOfQueue=%d\n", i, frameTable[i].occupied, frameTable[i].page, frameTable[i].dirty, frameTable[i].valid, frameTable[i].headOfQueue);
+                    sprintf(frameTableEntryString, "OSS: Frame table entry %d: occupied=%d, page=%d, owner=%d:%d, dirty=%d, valid=%d, headOfQueue=%d\n", i, frameTable[i].occupied, frameTable[i].page, pageTable[frameTable[i].page].pid, frameTable[i].page % NUM_PAGES_PER_PROCESS, frameTable[i].dirty, frameTable[i].valid, frameTable[i].headOfQueue);
                     strcat(frameTableString, frameTableEntryString);
                 }   
             }
@@ -658,7 +2038,7 @@ int main(int argc, char *argv[]) {
             for (int i = 0; i < MAX_PROCESSES; i++) {
                 if (processTable[i].occupied == 1) {
                     char processTableEntryString[256];
-                    sprintf(processTableEntryString, "OSS: Process table entry %d: pid=%d, eventWaitSec=%d, eventWaitNano=%d, neededPage=%d, blocked=%d\n", i, processTable[i].pid, processTable[i].eventWaitSec, processTable[i].eventWaitNano, processTable[i].neededPage, processTable[i].blocked);
+                    sprintf(processTableEntryString, "OSS: Process table entry %d: pid=%d, eventWaitSec=%d, eventWaitNano=%d, neededPage=%d, blocked=%d, resident=%d\n", i, processTable[i].pid, processTable[i].eventWaitSec, processTable[i].eventWaitNano, processTable[i].neededPage, processTable[i].blocked, processTable[i].residentCount);
                     strcat(processTableString, processTableEntryString);
                 }   
             }
@@ -670,11 +2050,51 @@ int main(int argc, char *argv[]) {
             nextOutputTime += 500000000;
         }
 
-        // Advance simulated clock 10ms
-        advanceClock(10000000);
+        // Advance simulated clock 10ms, stopping early at the next paging device completion so it is handled on time
+        long long tick = 10000000;
+        long long nextEvent = nextDeviceEvent();
+        if (nextEvent != -1 && nextEvent - getClockTime() < tick) {
+            tick = nextEvent > getClockTime() ? nextEvent - getClockTime() : 0;
+        }
+        advanceClock((int)tick);
 
+        // Let ossstat see where we are
+        publishTelemetry();
     }
 
 
     /* END MAIN LOOP */
+
+    /* SHUTDOWN */
+
+    if (stopSignal == SIGINT) {
+        sprintf(logMessage, "OSS: Caught SIGINT, exiting...\n");
+        printf("%s", logMessage);
+    } else if (stopSignal == SIGALRM) {
+        sprintf(logMessage, "OSS: Caught SIGALRM, exiting...\n");
+        printf("%s", logMessage);
+    }
+
+    logSummary(logfile);
+
+    // Save checkpoint
+    if (checkpointFile) {
+        syncBackingStore();
+        saveCheckpoint(checkpointFile);
+        char saveMessage[PATH_MAX + 100];
+        snprintf(saveMessage, sizeof(saveMessage), "OSS: Saved checkpoint %s at time %d:%d\n", checkpointFile, sysClock->seconds, sysClock->nanoseconds);
+        writeLog(logfile, saveMessage);
+    }
+
+    publishTelemetry();
+    cleanupTelemetry();
+    cleanupWorkerPool();
+    cleanupSharedMemory();
+    cleanupMessageQueue();
+    cleanupBackingStore();
+    cleanupSimState();
+
+    /* END SHUTDOWN */
+
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,158 @@
+// Jessica Seabolt CMP_SCI 4760 Project 6
+
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+
+#include "header.h"
+
+#define HEADER_EVERY 20
+
+// Global variables
+struct Telemetry *telemetry;
+char telemetryName[64];
+
+/* TELEMETRY FUNCTIONS */
+
+// Map oss's telemetry page read-only
+void attachTelemetry(int ossPid) {
+    sprintf(telemetryName, TELEMETRY_NAME_FORMAT, ossPid);
+    int fd = shm_open(telemetryName, O_RDONLY, 0);
+    if (fd < 0) {
+        perror("ossstat: Error: Failed to open telemetry page, is oss running with that pid?");
+        exit(EXIT_FAILURE);
+    }
+    telemetry = mmap(NULL, sizeof(struct Telemetry), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (telemetry == MAP_FAILED) {
+        perror("ossstat: Error: Failed to map telemetry page");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Check whether oss has exited
+int ossGone(int ossPid) {
+    return kill(ossPid, 0) == -1 && errno == ESRCH;
+}
+
+// Copy a consistent snapshot, retrying while oss is in the middle of an update
+// Returns 0 if oss died mid-update, since the page will never settle
+int readTelemetry(struct Telemetry *snapshot, int ossPid) {
+    struct timespec retryDelay = { 0, 1000000 };
+    while (1) {
+        unsigned int seq = __atomic_load_n(&telemetry->seq, __ATOMIC_ACQUIRE);
+        if (!(seq & 1)) {
+            *snapshot = *telemetry;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&telemetry->seq, __ATOMIC_RELAXED) == seq) {
+                return 1;
+            }
+        }
+        if (ossGone(ossPid)) {
+            return 0;
+        }
+        nanosleep(&retryDelay, NULL);
+    }
+}
+
+/* END TELEMETRY FUNCTIONS */
+
+/* OUTPUT FUNCTIONS */
+
+// Print column names
+void printHeader() {
+    printf("%14s %4s %4s %6s %5s %4s %5s %8s %8s %6s %6s %8s %8s %8s\n",
+        "clock", "act", "blk", "launch", "free", "ioq", "zswKB", "refs/s", "flts/s", "flt%", "tlb%", "zhits/s", "evict/s", "wback/s");
+}
+
+// Print one sample, rates are per real second since the last sample
+void printSample(struct Telemetry *now, struct Telemetry *last, double seconds) {
+    unsigned long references = now->references - last->references;
+    unsigned long pageFaults = now->pageFaults - last->pageFaults;
+    double faultRate = references > 0 ? 100.0 * pageFaults / references : 0.0;
+    double tlbHitRate = references > 0 ? 100.0 * (now->tlbHits - last->tlbHits) / references : 0.0;
+    printf("%4u.%09u %4d %4d %6d %5d %4d %5d %8.0f %8.0f %6.2f %6.2f %8.0f %8.0f %8.0f\n",
+        now->seconds, now->nanoseconds, now->activeProcesses, now->blockedProcesses, now->launchedProcesses, now->freeFrames, now->queueDepth,
+        now->zswapUsed / 1024, references / seconds, pageFaults / seconds, faultRate, tlbHitRate, (now->zswapHits - last->zswapHits) / seconds,
+        (now->evictions - last->evictions) / seconds, (now->writebacks - last->writebacks) / seconds);
+    fflush(stdout);
+}
+
+/* END OUTPUT FUNCTIONS */
+
+/* MAIN FUNCTION */
+
+// Main
+int main(int argc, char *argv[]) {
+    /* ARGUMENTS */
+
+    double interval = 1.0; // Seconds between samples
+    int count = -1; // Samples to print, -1 for until oss exits
+
+    int opt;
+    while ((opt = getopt(argc, argv, "hi:c:")) != -1) {
+        switch(opt) {
+            case 'h':
+                printf("Usage: %s [-h] [-i interval seconds] [-c count] oss pid\n", argv[0]);
+                exit(0);
+            case 'i':
+                interval = atof(optarg);
+                break;
+            case 'c':
+                count = atoi(optarg);
+                break;
+        }
+    }
+    if (optind >= argc || interval <= 0) {
+        fprintf(stderr, "Usage: %s [-h] [-i interval seconds] [-c count] oss pid\n", argv[0]);
+        exit(1);
+    }
+
+    /* END ARGUMENTS */
+
+    int ossPid = atoi(argv[optind]);
+    attachTelemetry(ossPid);
+
+    // Sample until told to stop or oss finishes
+    struct Telemetry last, now;
+    struct timespec lastTime, nowTime;
+    struct timespec delay = { (time_t)interval, (long)((interval - (time_t)interval) * 1000000000) };
+    int alive = readTelemetry(&last, ossPid);
+    clock_gettime(CLOCK_MONOTONIC, &lastTime);
+    for (int sample = 0; alive && (count == -1 || sample < count); sample++) {
+        nanosleep(&delay, NULL);
+        if (!readTelemetry(&now, ossPid)) {
+            alive = 0;
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &nowTime);
+
+        if (sample % HEADER_EVERY == 0) {
+            printHeader();
+        }
+        double seconds = (nowTime.tv_sec - lastTime.tv_sec) + (nowTime.tv_nsec - lastTime.tv_nsec) / 1e9;
+        printSample(&now, &last, seconds);
+
+        if (now.finished) {
+            break;
+        }
+
+        if (ossGone(ossPid)) {
+            alive = 0;
+            break;
+        }
+        last = now;
+        lastTime = nowTime;
+    }
+
+    // oss died without marking the page finished, so nobody else will remove it
+    if (!alive) {
+        fprintf(stderr, "ossstat: oss %d is gone\n", ossPid);
+        shm_unlink(telemetryName);
+    }
+
+    munmap(telemetry, sizeof(struct Telemetry));
+    return 0;
+}
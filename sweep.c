@@ -0,0 +1,301 @@
+// Jessica Seabolt CMP_SCI 4760 Project 6
+
+#include <fcntl.h>
+#include <string.h>
+#include <signal.h>
+
+#include "header.h"
+
+#define MAX_AXES 8
+#define MAX_VALUES 16
+#define MAX_RUNS 4096
+#define MAX_COLUMNS 32
+#define MAX_FIELD 32
+
+// One oss option and the values to sweep it over
+struct Axis {
+    char flag; // oss option letter
+    int numValues; // Number of values
+    char *values[MAX_VALUES]; // Values to try
+};
+
+// One oss run in the sweep
+struct Run {
+    pid_t pid; // oss process id, -1 when not running
+    int choice[MAX_AXES]; // Index into each axis' values
+    int numFields; // Number of summary fields parsed
+    char keys[MAX_COLUMNS][MAX_FIELD]; // Summary keys
+    char values[MAX_COLUMNS][MAX_FIELD]; // Summary values
+};
+
+// Global variables
+struct Axis axes[MAX_AXES];
+int numAxes = 0;
+struct Run runs[MAX_RUNS];
+int numRuns = 0;
+char runDir[] = "/tmp/sweep.XXXXXX";
+
+/* SETUP FUNCTIONS */
+
+// Parse an axis argument of the form flag=value,value,...
+void parseAxis(char *arg) {
+    if (numAxes == MAX_AXES) {
+        fprintf(stderr, "sweep: Error: Too many axes, limit is %d\n", MAX_AXES);
+        exit(EXIT_FAILURE);
+    }
+    if (strlen(arg) < 3 || arg[1] != '=') {
+        fprintf(stderr, "sweep: Error: Axis %s should look like m=64,128,256\n", arg);
+        exit(EXIT_FAILURE);
+    }
+
+    struct Axis *axis = &axes[numAxes++];
+    axis->flag = arg[0];
+    axis->numValues = 0;
+    for (char *value = strtok(arg + 2, ","); value != NULL; value = strtok(NULL, ",")) {
+        if (axis->numValues == MAX_VALUES) {
+            fprintf(stderr, "sweep: Error: Too many values for -%c, limit is %d\n", axis->flag, MAX_VALUES);
+            exit(EXIT_FAILURE);
+        }
+        axis->values[axis->numValues++] = value;
+    }
+}
+
+// Build the cross product of every axis
+void buildRuns() {
+    int choice[MAX_AXES] = {0};
+    while (1) {
+        if (numRuns == MAX_RUNS) {
+            fprintf(stderr, "sweep: Error: Too many runs, limit is %d\n", MAX_RUNS);
+            exit(EXIT_FAILURE);
+        }
+        runs[numRuns].pid = -1;
+        runs[numRuns].numFields = 0;
+        memcpy(runs[numRuns].choice, choice, sizeof(choice));
+        numRuns++;
+
+        // Advance like an odometer, last axis fastest
+        int a = numAxes - 1;
+        while (a >= 0 && ++choice[a] == axes[a].numValues) {
+            choice[a] = 0;
+            a--;
+        }
+        if (a < 0) {
+            return;
+        }
+    }
+}
+
+/* END SETUP FUNCTIONS */
+
+/* RUN FUNCTIONS */
+
+// Get the log file path of a run
+void getLogPath(int run, char *path) {
+    sprintf(path, "%s/run%d.log", runDir, run);
+}
+
+// Start one oss run with its output discarded
+pid_t startRun(int run) {
+    pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+
+    // oss and user_proc print every log line, nobody is watching
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    close(devNull);
+
+    // Build oss arguments
+    char *args[2 * MAX_AXES + 4];
+    char flags[MAX_AXES][3];
+    char logPath[64];
+    int numArgs = 0;
+    args[numArgs++] = "oss";
+    for (int a = 0; a < numAxes; a++) {
+        sprintf(flags[a], "-%c", axes[a].flag);
+        args[numArgs++] = flags[a];
+        args[numArgs++] = axes[a].values[runs[run].choice[a]];
+    }
+    getLogPath(run, logPath);
+    args[numArgs++] = "-f";
+    args[numArgs++] = logPath;
+    args[numArgs] = NULL;
+
+    execv("./oss", args);
+    perror("sweep: Error: Failed to exec oss");
+    exit(EXIT_FAILURE);
+}
+
+// Read the summary line oss writes at the end of its log
+void readSummary(int run) {
+    char logPath[64];
+    getLogPath(run, logPath);
+    FILE *log = fopen(logPath, "r");
+    if (log == NULL) {
+        return;
+    }
+
+    // Keep the last summary line
+    char line[1024], summary[1024] = "";
+    while (fgets(line, sizeof(line), log) != NULL) {
+        if (strncmp(line, "OSS: Summary: ", 14) == 0) {
+            strcpy(summary, line + 14);
+        }
+    }
+    fclose(log);
+    unlink(logPath);
+
+    // Split into key=value fields
+    struct Run *r = &runs[run];
+    for (char *field = strtok(summary, " \n"); field != NULL && r->numFields < MAX_COLUMNS; field = strtok(NULL, " \n")) {
+        char *equals = strchr(field, '=');
+        if (equals == NULL) {
+            continue;
+        }
+        *equals = '\0';
+        snprintf(r->keys[r->numFields], MAX_FIELD, "%s", field);
+        snprintf(r->values[r->numFields], MAX_FIELD, "%s", equals + 1);
+        r->numFields++;
+    }
+}
+
+/* END RUN FUNCTIONS */
+
+/* OUTPUT FUNCTIONS */
+
+// Print every run as one row, configuration first then the summary fields
+void printTable() {
+    // Use the first run that finished for the column names
+    int header = -1;
+    for (int i = 0; i < numRuns && header == -1; i++) {
+        if (runs[i].numFields > 0) {
+            header = i;
+        }
+    }
+    if (header == -1) {
+        fprintf(stderr, "sweep: Error: No run produced a summary\n");
+        return;
+    }
+
+    // Size each column to its widest entry
+    int configWidth[MAX_AXES], fieldWidth[MAX_COLUMNS];
+    for (int a = 0; a < numAxes; a++) {
+        configWidth[a] = 2;
+        for (int v = 0; v < axes[a].numValues; v++) {
+            int len = strlen(axes[a].values[v]);
+            if (len > configWidth[a]) {
+                configWidth[a] = len;
+            }
+        }
+    }
+    for (int f = 0; f < runs[header].numFields; f++) {
+        fieldWidth[f] = strlen(runs[header].keys[f]);
+        for (int i = 0; i < numRuns; i++) {
+            int len = f < runs[i].numFields ? strlen(runs[i].values[f]) : 1;
+            if (len > fieldWidth[f]) {
+                fieldWidth[f] = len;
+            }
+        }
+    }
+
+    // Header
+    for (int a = 0; a < numAxes; a++) {
+        char flag[3];
+        sprintf(flag, "-%c", axes[a].flag);
+        printf("%*s ", configWidth[a], flag);
+    }
+    for (int f = 0; f < runs[header].numFields; f++) {
+        printf(" %*s", fieldWidth[f], runs[header].keys[f]);
+    }
+    printf("\n");
+
+    // Rows
+    for (int i = 0; i < numRuns; i++) {
+        for (int a = 0; a < numAxes; a++) {
+            printf("%*s ", configWidth[a], axes[a].values[runs[i].choice[a]]);
+        }
+        for (int f = 0; f < runs[header].numFields; f++) {
+            printf(" %*s", fieldWidth[f], f < runs[i].numFields ? runs[i].values[f] : "-");
+        }
+        printf("\n");
+    }
+}
+
+/* END OUTPUT FUNCTIONS */
+
+/* MAIN FUNCTION */
+
+// Main
+int main(int argc, char *argv[]) {
+    /* ARGUMENTS */
+
+    int jobs = sysconf(_SC_NPROCESSORS_ONLN); // Runs at a time, one per core by default
+
+    int opt;
+    while ((opt = getopt(argc, argv, "hj:")) != -1) {
+        switch(opt) {
+            case 'h':
+                printf("Usage: %s [-h] [-j jobs] flag=value,value,... ...\n", argv[0]);
+                printf("Runs oss once for every combination of values, e.g. %s n=50 s=4,18 m=64,128,256 w=5,15,50\n", argv[0]);
+                exit(0);
+            case 'j':
+                jobs = atoi(optarg);
+                break;
+        }
+    }
+    for (int i = optind; i < argc; i++) {
+        parseAxis(argv[i]);
+    }
+    if (jobs < 1) {
+        jobs = 1;
+    }
+
+    /* END ARGUMENTS */
+
+    /* RUN SWEEP */
+
+    if (mkdtemp(runDir) == NULL) {
+        perror("sweep: Error: Failed to create run directory");
+        exit(EXIT_FAILURE);
+    }
+    buildRuns();
+
+    // Keep up to jobs runs going, each oss uses its own private IPC so they cannot collide
+    int nextRun = 0, running = 0, finished = 0;
+    while (finished < numRuns) {
+        while (running < jobs && nextRun < numRuns) {
+            runs[nextRun].pid = startRun(nextRun);
+            if (runs[nextRun].pid == -1) {
+                perror("sweep: Error: Failed to fork");
+                exit(EXIT_FAILURE);
+            }
+            nextRun++;
+            running++;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid == -1) {
+            perror("sweep: Error: Failed to wait for oss");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < nextRun; i++) {
+            if (runs[i].pid == pid) {
+                runs[i].pid = -1;
+                readSummary(i);
+                running--;
+                finished++;
+                fprintf(stderr, "sweep: %d/%d runs finished\r", finished, numRuns);
+                break;
+            }
+        }
+    }
+    fprintf(stderr, "\n");
+    rmdir(runDir);
+
+    /* END RUN SWEEP */
+
+    printTable();
+    return 0;
+}
@@ -1,5 +1,7 @@
 // Jessica Seabolt 11/17/2023 CMP_SCI 4760 Project 6
 
+#include <string.h>
+
 #include "header.h"
 
 #define _GNU_SOURCE
@@ -7,6 +9,8 @@
 // Global variables
 int shmid;
 int msqid;
+int writePercent = DEFAULT_WRITE_PERCENT;
+int lifetime = 0; // Mean references before terminating, 0 for the original odds
 char logMessage[150];
 struct SystemClock *sysClock;
 struct msgbuf inbox, outbox;
@@ -15,14 +19,7 @@ struct msgbuf inbox, outbox;
 
 // Init shared memory
 void initSharedMemory() {
-    // Get shared memory
-    shmid = shmget(SHMKEY, sizeof(struct SystemClock), IPC_CREAT | 0666);
-    if (shmid == -1) {
-        perror("user_proc: Error: Failed to get shared memory");
-        exit(EXIT_FAILURE);
-    }
-    
-    // Attach shared memory
+    // Attach shared memory created by oss
     sysClock = (struct SystemClock *)shmat(shmid, NULL, 0);
     if (sysClock == (void *)-1) {
         perror("user_proc: Error: Failed to attach shared memory");
@@ -32,28 +29,14 @@ void initSharedMemory() {
 
 // Init message queue
 void initMessageQueue() {
-    // Get message queue
-    msqid = msgget(MSGKEY, IPC_CREAT | 0666);
-    if (msqid == -1) {
-        perror("user_proc: Error: Failed to get message queue");
-        exit(EXIT_FAILURE);
-    }
+    // Message queue id is handed to us by oss
     inbox.mType = getpid();
     inbox.mData.pid = getpid();
     outbox.mType = 1;
 }
 
-// Main
-int main(int argc, char *argv[]) {
-    // Init shared memory
-    initSharedMemory();
-    
-    // Init message queue
-    initMessageQueue();
-
-    // Seed random
-    srand(getpid());
-    
+// Run one workload, returns once the process decides to terminate
+void runWorkload() {
     // Loop
     while (1) {       
         // Generate page
@@ -67,10 +50,10 @@ int main(int argc, char *argv[]) {
 
         // Determine if read or write
         int readOrWrite = rand() % 100;
-        if (readOrWrite < 85) {
-            readOrWrite = 0;
+        if (readOrWrite < 100 - writePercent) {
+            readOrWrite = MSG_READ;
         } else {
-            readOrWrite = 1;
+            readOrWrite = MSG_WRITE;
         }
 
         // Send message to oss with address and read/write
@@ -89,22 +72,73 @@ int main(int argc, char *argv[]) {
             exit(EXIT_FAILURE);
         }
 
-        // Check if terminate every 1000 ± 100 memory references
-        int terminate = rand() % 1100;
-        if (terminate >= 900) {
-            // Detach shared memory
-            if (shmdt(sysClock) == -1) {
-                perror("user_proc: Error: Failed to detach shared memory");
-                exit(EXIT_FAILURE);
-            }
-            
+        // Check if terminate, 200 in 1100 odds unless oss gave us a mean lifetime
+        int terminate = lifetime > 0 ? rand() % lifetime == 0 : rand() % 1100 >= 900;
+        if (terminate) {
             printf("User process %d terminated\n", getpid());
-
-            // Exit
-            exit(EXIT_SUCCESS);
+            return;
         }
 
     }
+}
+
+// Main
+int main(int argc, char *argv[]) {
+    // oss passes its private shared memory and message queue ids
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s shmid msqid [write percent] [lifetime] [pool]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    shmid = atoi(argv[1]);
+    msqid = atoi(argv[2]);
+    if (argc > 3) {
+        writePercent = atoi(argv[3]);
+    }
+    if (argc > 4) {
+        lifetime = atoi(argv[4]);
+    }
+    int pooled = argc > 5 && strcmp(argv[5], "pool") == 0;
+
+    // Init shared memory
+    initSharedMemory();
     
-    return 0;
-}
\ No newline at end of file
+    // Init message queue
+    initMessageQueue();
+
+    // A pooled worker parks until oss assigns it a workload, runs it, reports back and parks again
+    while (pooled) {
+        if (msgrcv(msqid, &inbox, sizeof(inbox.mData), getpid(), 0) == -1) {
+            exit(EXIT_FAILURE);
+        }
+        if (inbox.mData.readWrite != MSG_ASSIGN) {
+            continue;
+        }
+
+        // Seed random with the workload oss handed us
+        srand(inbox.mData.address);
+        runWorkload();
+
+        // Tell oss we are done so it can free our resources
+        outbox.mData.pid = getpid();
+        outbox.mData.address = 0;
+        outbox.mData.readWrite = MSG_EXIT;
+        if (msgsnd(msqid, &outbox, sizeof(outbox.mData), 0) == -1) {
+            perror("user_proc: Error: Failed to send message to oss");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Seed random
+    srand(getpid());
+
+    runWorkload();
+
+    // Detach shared memory
+    if (shmdt(sysClock) == -1) {
+        perror("user_proc: Error: Failed to detach shared memory");
+        exit(EXIT_FAILURE);
+    }
+
+    // Exit
+    return EXIT_SUCCESS;
+}